@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include "arena.h"
+#include "newdelete.h"
+
+namespace homework3 {
+
+// Chunks are kept in a list from the most recently allocated one.
+struct arena::chunk_header {
+  chunk_header* prev;
+  std::size_t size;
+};
+
+arena::arena(std::size_t _initial_size)
+  : initial_size{_initial_size}, next_size{_initial_size}
+{
+  if(0 == initial_size)
+    throw std::invalid_argument("arena requires non-zero initial size");
+}
+
+arena::~arena()
+{
+  release();
+}
+
+void arena::reset()
+{
+  if(nullptr == chunks)
+    return;
+
+  if(nullptr != chunks->prev) {
+    std::size_t size{};
+    for(auto chunk = chunks; nullptr != chunk; chunk = chunk->prev)
+      size += chunk->size;
+    release();
+    next_size = size;
+    allocate_chunk(0, 1);
+  }
+  current = reinterpret_cast<char*>(chunks + 1);
+  end = reinterpret_cast<char*>(chunks) + chunks->size;
+}
+
+void arena::release() noexcept
+{
+  while(nullptr != chunks) {
+    auto prev = chunks->prev;
+    homework3::free(chunks);
+    chunks = prev;
+  }
+  current = nullptr;
+  end = nullptr;
+  next_size = initial_size;
+}
+
+void* arena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+  auto space = static_cast<std::size_t>(end - current);
+  void* p = current;
+  if((nullptr == current) || (nullptr == std::align(alignment, bytes, p, space))) {
+    allocate_chunk(bytes, alignment);
+    space = end - current;
+    p = current;
+    std::align(alignment, bytes, p, space);
+  }
+  current = static_cast<char*>(p) + bytes;
+  return p;
+}
+
+void arena::do_deallocate(void*, std::size_t, std::size_t)
+{
+}
+
+bool arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+void arena::allocate_chunk(std::size_t bytes, std::size_t alignment)
+{
+  if(std::numeric_limits<std::size_t>::max() - sizeof(chunk_header) - alignment < bytes)
+    throw std::bad_alloc();
+  const auto size = std::max(next_size, sizeof(chunk_header) + alignment + bytes);
+
+  auto p = homework3::malloc(size);
+  if(!p)
+    throw std::bad_alloc();
+  chunks = new(p) chunk_header{chunks, size};
+  current = reinterpret_cast<char*>(chunks + 1);
+  end = static_cast<char*>(p) + size;
+  if(std::numeric_limits<std::size_t>::max() / 2 >= size)
+    next_size = 2 * size;
+}
+
+}
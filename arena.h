@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace homework3 {
+
+// Monotonic memory resource. Memory is handed out from chunks by bumping a pointer and is
+// never given back one allocation at a time: deallocate does nothing, all of it is released
+// at once by release() or by the destructor, or is rewound for reuse by reset(). Every next
+// chunk is twice as large as the previous one. Not thread-safe.
+class arena : public std::pmr::memory_resource {
+
+public:
+
+  static constexpr std::size_t default_initial_size = 4096;
+
+  explicit arena(std::size_t initial_size = default_initial_size);
+  ~arena();
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+
+  // Starts to allocate from the beginning again. Several chunks are replaced by one chunk
+  // of their total size, so the same amount of memory is allocated without going to malloc.
+  void reset();
+
+  // Returns all chunks to malloc.
+  void release() noexcept;
+
+protected:
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+
+  struct chunk_header;
+
+  void allocate_chunk(std::size_t bytes, std::size_t alignment);
+
+  const std::size_t initial_size;
+  std::size_t next_size;
+  chunk_header* chunks{nullptr};
+  char* current{nullptr};
+  char* end{nullptr};
+};
+
+}
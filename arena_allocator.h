@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include "arena.h"
+
+namespace homework3 {
+
+// Handle to a reference-counted arena. Deallocation is a no-op, memory of all the elements
+// is released together with the arena, or reused after arena::reset(). Meant for containers
+// that are built, used and thrown away as a whole. Copies and rebinds share the arena and
+// compare equal.
+template<typename T>
+class arena_allocator {
+
+  template<typename> friend class arena_allocator;
+
+public:
+
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  template<typename U> struct rebind { typedef arena_allocator<U> other; };
+
+  arena_allocator()
+    : memory{std::make_shared<arena>()} {}
+
+  // A moved-from allocator must still compare equal to the new one, so moves copy the handle.
+  arena_allocator(const arena_allocator&) = default;
+  arena_allocator& operator=(const arena_allocator&) = default;
+
+  explicit arena_allocator(std::shared_ptr<arena> _memory) noexcept
+    : memory{std::move(_memory)} {}
+
+  template<typename U>
+  arena_allocator(const arena_allocator<U>& other) noexcept
+    : memory{other.memory} {}
+
+  const std::shared_ptr<arena>& get_arena() const noexcept {
+    return memory;
+  }
+
+  pointer allocate(std::size_t n) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+
+    if(std::numeric_limits<std::size_t>::max() / sizeof(T) < n)
+      throw std::bad_alloc();
+    return static_cast<pointer>(memory->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(pointer, std::size_t) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+  }
+
+  template<typename ... Args >
+  void construct(pointer p, Args&&... args) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+    new(p) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(pointer p) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+    p->~T();
+  }
+
+private:
+
+  std::shared_ptr<arena> memory;
+};
+
+template<typename T, typename U>
+bool operator==(const arena_allocator<T>& lhs, const arena_allocator<U>& rhs) noexcept
+{
+  return lhs.get_arena() == rhs.get_arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const arena_allocator<T>& lhs, const arena_allocator<U>& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
+}
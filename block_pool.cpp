@@ -0,0 +1,779 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include "block_pool.h"
+#include "newdelete.h"
+
+namespace homework3 {
+
+namespace {
+
+constexpr std::size_t bits_per_word = 64;
+constexpr std::uint64_t full_word = ~std::uint64_t{};
+
+// Unused slot keeps the pointer to the next unused slot of the block in its own storage.
+struct free_slot {
+  free_slot* next;
+};
+
+std::size_t round_up(std::size_t value, std::size_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+std::size_t round_up_to_power_of_2(std::size_t value)
+{
+  std::size_t result{1};
+  while(result < value)
+    result <<= 1;
+  return result;
+}
+
+std::size_t count_trailing_zeros(std::uint64_t word) noexcept
+{
+  return __builtin_ctzll(word);
+}
+
+}
+
+double pool_stats::fragmentation() const noexcept
+{
+  if(0 == capacity_slots)
+    return 0.0;
+  return static_cast<double>(capacity_slots - live_slots) / capacity_slots;
+}
+
+double pool_stats::average_scan_length() const noexcept
+{
+  if(0 == allocations)
+    return 0.0;
+  return static_cast<double>(scanned_blocks) / allocations;
+}
+
+pool_stats& pool_stats::operator+=(const pool_stats& other) noexcept
+{
+  live_slots += other.live_slots;
+  capacity_slots += other.capacity_slots;
+  blocks += other.blocks;
+  spare_blocks += other.spare_blocks;
+  chunks += other.chunks;
+  peak_live_slots += other.peak_live_slots;
+  allocations += other.allocations;
+  deallocations += other.deallocations;
+  large_allocations += other.large_allocations;
+  scanned_blocks += other.scanned_blocks;
+  return *this;
+}
+
+growth_policy fixed_growth(std::size_t blocks_per_chunk)
+{
+  return [blocks_per_chunk] (std::size_t) {
+    return blocks_per_chunk;
+  };
+}
+
+growth_policy geometric_growth(std::size_t max_blocks_per_chunk)
+{
+  return [max_blocks_per_chunk] (std::size_t chunks_count) {
+    if(std::numeric_limits<std::size_t>::digits <= chunks_count)
+      return max_blocks_per_chunk;
+    return std::min(std::size_t{1} << chunks_count, max_blocks_per_chunk);
+  };
+}
+
+namespace detail {
+
+pool_stats pool_counters::load() const noexcept
+{
+  pool_stats stats;
+  stats.live_slots = live_slots.load();
+  stats.capacity_slots = capacity_slots.load();
+  stats.blocks = blocks.load();
+  stats.spare_blocks = spare_blocks.load();
+  stats.chunks = chunks.load();
+  stats.peak_live_slots = peak_live_slots.load();
+  stats.allocations = allocations.load();
+  stats.deallocations = deallocations.load();
+  stats.large_allocations = large_allocations.load(std::memory_order_relaxed);
+  stats.scanned_blocks = scanned_blocks.load();
+  return stats;
+}
+
+// In free_list mode slots past bump were never used and are handed out in order, without
+// threading them into the free list first. They are also the source of contiguous runs.
+// In bitset mode the header is followed by occupancy words, bits past slots_per_block in
+// the last word are always set. Every block refers to the first block of its chunk, which
+// counts the blocks of the chunk and the blocks that are not spare.
+struct slot_pool::block_header {
+  block_header* prev;
+  block_header* next;
+  std::size_t used;
+  free_slot* free_slots;
+  std::size_t bump;
+  block_header* chunk;
+  std::size_t chunk_blocks;
+  std::size_t chunk_live_blocks;
+};
+
+slot_pool::slot_pool(std::size_t size, std::size_t alignment, std::size_t _slots_per_block, allocation_mode _mode,
+                     const growth_policy& _growth, backing_store _backing, std::size_t retained_empty_blocks,
+                     pool_counters& _counters)
+  : requested_size{size},
+    slot_alignment{std::max(alignment, alignof(free_slot))},
+    slot_size{round_up(std::max(size, sizeof(free_slot)), slot_alignment)},
+    slots_per_block{_slots_per_block},
+    mode{_mode},
+    words_count{(allocation_mode::bitset == mode) ? (slots_per_block + bits_per_word - 1) / bits_per_word : 0},
+    slots_offset{round_up(sizeof(block_header) + words_count * sizeof(std::uint64_t), slot_alignment)},
+    block_size{round_up_to_power_of_2(slots_offset + slots_per_block * slot_size)},
+    growth{_growth},
+    backing{_backing},
+    retained_limit{retained_empty_blocks},
+    counters(_counters)
+{
+  if(0 == slots_per_block)
+    throw std::invalid_argument("slot_pool requires at least one slot per block");
+}
+
+slot_pool::~slot_pool()
+{
+  while(first)
+    release_block(first);
+  trim();
+}
+
+bool slot_pool::fits(std::size_t size, std::size_t alignment) const noexcept
+{
+  return (requested_size == size) && (slot_alignment >= alignment);
+}
+
+void* slot_pool::allocate(std::size_t n)
+{
+  auto p = (allocation_mode::bitset == mode) ? allocate_from_bitset(n) : allocate_from_free_list(n);
+  counters.allocations.add(1);
+  counters.live_slots.add(n);
+  counters.peak_live_slots.raise_to(counters.live_slots.load());
+  return p;
+}
+
+void slot_pool::allocate_bulk(void** slots, std::size_t n)
+{
+  std::size_t i{0};
+  if(allocation_mode::bitset == mode) {
+    try {
+      for(; i < n; ++i)
+        slots[i] = allocate(1);
+    }
+    catch(...) {
+      for(std::size_t j = 0; j < i; ++j)
+        deallocate(slots[j], 1);
+      throw;
+    }
+    return;
+  }
+
+  // Every block gives all slots it can at once and is scanned once. Each slot counts as
+  // an allocation, as each is deallocated on its own.
+  try {
+    while(i < n) {
+      auto block = first;
+      if((nullptr == block) || (slots_per_block == block->used))
+        block = allocate_block();
+      counters.scanned_blocks.add(1);
+
+      const auto taken_before = i;
+      for(; (i < n) && (nullptr != block->free_slots); ++i) {
+        slots[i] = block->free_slots;
+        block->free_slots = block->free_slots->next;
+      }
+      for(; (i < n) && (slots_per_block != block->bump); ++i)
+        slots[i] = slots_of(block) + block->bump++ * slot_size;
+
+      block->used += i - taken_before;
+      counters.allocations.add(i - taken_before);
+      counters.live_slots.add(i - taken_before);
+      if(slots_per_block == block->used)
+        move_to_back(block);
+    }
+  }
+  catch(...) {
+    for(std::size_t j = 0; j < i; ++j)
+      deallocate(slots[j], 1);
+    throw;
+  }
+  counters.peak_live_slots.raise_to(counters.live_slots.load());
+}
+
+void slot_pool::deallocate(void* p, std::size_t n) noexcept
+{
+  auto block = owner_of(p);
+  const bool was_full = (slots_per_block == block->used);
+
+  if(allocation_mode::bitset == mode) {
+    std::size_t position = (static_cast<char*>(p) - slots_of(block)) / slot_size;
+    if(0 == (words_of(block)[position / bits_per_word] & (std::uint64_t{1} << (position % bits_per_word))))
+      return;
+    flip(block, position, n);
+  }
+  else {
+    auto released_slot = static_cast<char*>(p);
+    for(std::size_t i = 0; i < n; ++i, released_slot += slot_size) {
+      auto slot = reinterpret_cast<free_slot*>(released_slot);
+      slot->next = block->free_slots;
+      block->free_slots = slot;
+    }
+  }
+
+  counters.deallocations.add(1);
+  counters.live_slots.subtract(n);
+
+  block->used -= n;
+  if(0 == block->used)
+    release_block(block);
+  else if(was_full)
+    move_to_front(block);
+}
+
+slot_pool::block_header* slot_pool::owner_of(const void* p) const noexcept
+{
+  return reinterpret_cast<block_header*>(reinterpret_cast<std::uintptr_t>(p) & ~(block_size - 1));
+}
+
+char* slot_pool::slots_of(block_header* block) const noexcept
+{
+  return reinterpret_cast<char*>(block) + slots_offset;
+}
+
+std::uint64_t* slot_pool::words_of(block_header* block) const noexcept
+{
+  return reinterpret_cast<std::uint64_t*>(block + 1);
+}
+
+void* slot_pool::allocate_from_free_list(std::size_t n)
+{
+  // Blocks with free slots are kept at the front, so full blocks are never inspected.
+  auto block = first;
+  if((nullptr == block) || (slots_per_block == block->used))
+    block = allocate_block();
+  counters.scanned_blocks.add(1);
+
+  void* p{nullptr};
+  if((1 == n) && (nullptr != block->free_slots)) {
+    p = block->free_slots;
+    block->free_slots = block->free_slots->next;
+  }
+  else {
+    if(slots_per_block - block->bump < n)
+      block = allocate_block();
+    p = slots_of(block) + block->bump * slot_size;
+    block->bump += n;
+  }
+
+  block->used += n;
+  if(slots_per_block == block->used)
+    move_to_back(block);
+  return p;
+}
+
+void* slot_pool::allocate_from_bitset(std::size_t n)
+{
+  auto block = first;
+  std::size_t position{};
+  std::size_t scanned{};
+  for(; (nullptr != block) && (slots_per_block != block->used); block = block->next) {
+    ++scanned;
+    if((slots_per_block - block->used >= n) && find_run(block, n, position))
+      break;
+  }
+  counters.scanned_blocks.add(std::max(scanned, std::size_t{1}));
+
+  if((nullptr == block) || (slots_per_block == block->used)) {
+    block = allocate_block();
+    position = 0;
+  }
+
+  flip(block, position, n);
+  block->used += n;
+  if(slots_per_block == block->used)
+    move_to_back(block);
+  return slots_of(block) + position * slot_size;
+}
+
+bool slot_pool::find_run(block_header* block, std::size_t n, std::size_t& position) const noexcept
+{
+  auto words = words_of(block);
+  if(1 == n) {
+    std::size_t word{};
+    while(full_word == words[word])
+      ++word;
+    position = word * bits_per_word + count_trailing_zeros(~words[word]);
+    return true;
+  }
+
+  std::size_t run_length{};
+  for(std::size_t i = 0; i < slots_per_block; ++i) {
+    if((0 == i % bits_per_word) && (full_word == words[i / bits_per_word])) {
+      run_length = 0;
+      i += bits_per_word - 1;
+      continue;
+    }
+    if(0 != (words[i / bits_per_word] & (std::uint64_t{1} << (i % bits_per_word)))) {
+      run_length = 0;
+      continue;
+    }
+    if(n == ++run_length) {
+      position = i + 1 - n;
+      return true;
+    }
+  }
+  return false;
+}
+
+void slot_pool::flip(block_header* block, std::size_t position, std::size_t n) const noexcept
+{
+  auto words = words_of(block);
+  for(auto i = position; i < position + n; ++i)
+    words[i / bits_per_word] ^= std::uint64_t{1} << (i % bits_per_word);
+}
+
+slot_pool::block_header* slot_pool::allocate_block()
+{
+  auto block = spare;
+  if(nullptr == block)
+    block = allocate_chunk();
+  unlink_spare(block);
+  if(0 == block->chunk->chunk_live_blocks++)
+    retained_blocks -= block->chunk->chunk_blocks;
+  counters.blocks.add(1);
+  counters.spare_blocks.subtract(1);
+  counters.capacity_slots.add(slots_per_block);
+
+  init_block(block);
+  link_front(block);
+  return block;
+}
+
+slot_pool::block_header* slot_pool::allocate_chunk()
+{
+  auto blocks = std::max(growth(chunks_count), std::size_t{1});
+  if(backing_store::heap != backing) {
+    const auto chunk_size = (backing_store::huge_pages == backing) ? huge_page_size : homework3::page_size();
+    blocks = std::max(blocks, (chunk_size + block_size - 1) / block_size);
+  }
+  if(std::numeric_limits<std::size_t>::max() / block_size < blocks)
+    throw std::bad_alloc();
+
+  auto p = (backing_store::heap == backing) ? homework3::aligned_malloc(block_size, blocks * block_size)
+                                            : homework3::map_pages(std::max(block_size, (backing_store::huge_pages == backing) ? huge_page_size : 0),
+                                                                   blocks * block_size,
+                                                                   backing_store::huge_pages == backing);
+  if(!p)
+    throw std::bad_alloc();
+  ++chunks_count;
+  counters.chunks.add(1);
+
+  auto chunk = static_cast<block_header*>(p);
+  for(std::size_t i = blocks; i > 0; --i) {
+    auto block = new(static_cast<char*>(p) + (i - 1) * block_size) block_header{};
+    block->chunk = chunk;
+    push_spare(block);
+  }
+  chunk->chunk_blocks = blocks;
+  retained_blocks += blocks;
+  counters.spare_blocks.add(blocks);
+  return chunk;
+}
+
+void slot_pool::init_block(block_header* block) const noexcept
+{
+  block->used = 0;
+  block->free_slots = nullptr;
+  block->bump = 0;
+  if(0 != words_count) {
+    auto words = words_of(block);
+    std::fill(words, words + words_count, std::uint64_t{});
+    if(0 != slots_per_block % bits_per_word)
+      words[words_count - 1] = full_word << (slots_per_block % bits_per_word);
+  }
+}
+
+void slot_pool::release_block(block_header* block) noexcept
+{
+  unlink(block);
+  push_spare(block);
+  counters.blocks.subtract(1);
+  counters.spare_blocks.add(1);
+  counters.capacity_slots.subtract(slots_per_block);
+
+  auto chunk = block->chunk;
+  if(0 != --chunk->chunk_live_blocks) {
+    if(backing_store::heap != backing)
+      homework3::discard_pages(slots_of(block), block_size - slots_offset);
+    return;
+  }
+
+  if(retained_blocks + chunk->chunk_blocks <= retained_limit) {
+    retained_blocks += chunk->chunk_blocks;
+    return;
+  }
+  release_chunk(chunk);
+}
+
+void slot_pool::release_chunk(block_header* chunk) noexcept
+{
+  const auto blocks = chunk->chunk_blocks;
+  for(std::size_t i = 0; i < blocks; ++i)
+    unlink_spare(reinterpret_cast<block_header*>(reinterpret_cast<char*>(chunk) + i * block_size));
+  for(std::size_t i = 0; i < blocks; ++i)
+    reinterpret_cast<block_header*>(reinterpret_cast<char*>(chunk) + i * block_size)->~block_header();
+  if(backing_store::heap == backing)
+    homework3::free(chunk);
+  else
+    homework3::unmap_pages(chunk, blocks * block_size);
+  --chunks_count;
+  counters.chunks.subtract(1);
+  counters.spare_blocks.subtract(blocks);
+}
+
+void slot_pool::trim() noexcept
+{
+  auto block = spare;
+  while(nullptr != block) {
+    auto chunk = block->chunk;
+    if(0 != chunk->chunk_live_blocks) {
+      block = block->next;
+      continue;
+    }
+    // Blocks of the chunk may follow the current one, so the list is walked again.
+    retained_blocks -= chunk->chunk_blocks;
+    release_chunk(chunk);
+    block = spare;
+  }
+}
+
+void slot_pool::push_spare(block_header* block) noexcept
+{
+  block->prev = nullptr;
+  block->next = spare;
+  if(spare)
+    spare->prev = block;
+  spare = block;
+}
+
+void slot_pool::unlink_spare(block_header* block) noexcept
+{
+  if(block->prev)
+    block->prev->next = block->next;
+  else
+    spare = block->next;
+  if(block->next)
+    block->next->prev = block->prev;
+}
+
+void slot_pool::move_to_front(block_header* block) noexcept
+{
+  unlink(block);
+  link_front(block);
+}
+
+void slot_pool::move_to_back(block_header* block) noexcept
+{
+  unlink(block);
+  link_back(block);
+}
+
+void slot_pool::link_front(block_header* block) noexcept
+{
+  block->prev = nullptr;
+  block->next = first;
+  if(first)
+    first->prev = block;
+  else
+    last = block;
+  first = block;
+}
+
+void slot_pool::link_back(block_header* block) noexcept
+{
+  block->next = nullptr;
+  block->prev = last;
+  if(last)
+    last->next = block;
+  else
+    first = block;
+  last = block;
+}
+
+void slot_pool::unlink(block_header* block) noexcept
+{
+  if(block->prev)
+    block->prev->next = block->next;
+  else
+    first = block->next;
+  if(block->next)
+    block->next->prev = block->prev;
+  else
+    last = block->prev;
+}
+
+}
+
+block_pool::block_pool(std::size_t slots_per_block, allocation_mode mode, std::size_t largest_pooled_size, growth_policy growth,
+                       slot_padding padding, backing_store backing, std::size_t retained_empty_blocks)
+  : slots_count{slots_per_block},
+    pools_mode{mode},
+    largest_pooled{largest_pooled_size},
+    chunks_growth{std::move(growth)},
+    slots_padding{padding},
+    chunks_backing{backing},
+    retained_limit{retained_empty_blocks}
+{
+  if(0 == slots_count)
+    throw std::invalid_argument("block_pool requires at least one slot per block");
+}
+
+block_pool::~block_pool()
+{
+  if(!registered.load(std::memory_order_acquire))
+    return;
+
+  auto stats = counters.load();
+  stats.live_slots = 0;
+  stats.capacity_slots = 0;
+  stats.blocks = 0;
+  stats.spare_blocks = 0;
+  stats.chunks = 0;
+
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  retired_stats() += stats;
+  if(prev_pool)
+    prev_pool->next_pool = next_pool;
+  else
+    registry() = next_pool;
+  if(next_pool)
+    next_pool->prev_pool = prev_pool;
+}
+
+pool_stats block_pool::global_stats() noexcept
+{
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  auto stats = retired_stats();
+  for(auto pool = registry(); nullptr != pool; pool = pool->next_pool)
+    stats += pool->stats();
+  return stats;
+}
+
+void block_pool::register_pool() noexcept
+{
+  if(registered.load(std::memory_order_acquire))
+    return;
+
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  if(registered.load(std::memory_order_relaxed))
+    return;
+  next_pool = registry();
+  if(next_pool)
+    next_pool->prev_pool = this;
+  registry() = this;
+  registered.store(true, std::memory_order_release);
+}
+
+std::mutex& block_pool::registry_mutex() noexcept
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+block_pool*& block_pool::registry() noexcept
+{
+  static block_pool* first_pool{nullptr};
+  return first_pool;
+}
+
+pool_stats& block_pool::retired_stats() noexcept
+{
+  static pool_stats stats;
+  return stats;
+}
+
+void* block_pool::do_allocate_slots(std::size_t size, std::size_t alignment, std::size_t n)
+{
+  if(slots_count < n) {
+    if(std::numeric_limits<std::size_t>::max() / size < n)
+      throw std::bad_alloc();
+    return allocate_large(n * size, alignment);
+  }
+  auto& pool = pool_for(size, alignment);
+  return pool.allocate(slots_for(pool, size, n));
+}
+
+void block_pool::do_allocate_slots_bulk(std::size_t size, std::size_t alignment, void** slots, std::size_t n)
+{
+  auto& pool = pool_for(size, alignment);
+  pool.allocate_bulk(slots, n);
+}
+
+void block_pool::do_deallocate_slots(void* p, std::size_t size, std::size_t alignment, std::size_t n) noexcept
+{
+  if(slots_count < n) {
+    deallocate_large(p);
+    return;
+  }
+  auto& pool = pool_for(size, alignment);
+  pool.deallocate(p, slots_for(pool, size, n));
+}
+
+void* block_pool::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+  if(largest_pooled < bytes)
+    return allocate_large(bytes, alignment);
+  return allocate_slots(bytes, alignment, 1);
+}
+
+void block_pool::do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+{
+  if(largest_pooled < bytes)
+    deallocate_large(p);
+  else
+    deallocate_slots(p, bytes, alignment, 1);
+}
+
+bool block_pool::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+detail::slot_pool& block_pool::pool_for(std::size_t size, std::size_t alignment)
+{
+  if(slot_padding::cache_line == slots_padding)
+    alignment = std::max(alignment, cache_line_size);
+
+  if((size_class_granularity >= alignment) && (largest_size_class >= size)) {
+    auto& pool = size_classes[(std::max(size, std::size_t{1}) - 1) / size_class_granularity];
+    if(!pool) {
+      register_pool();
+      pool = std::make_unique<detail::slot_pool>(round_up(std::max(size, std::size_t{1}), size_class_granularity),
+                                                 size_class_granularity,
+                                                 slots_count,
+                                                 pools_mode,
+                                                 chunks_growth,
+                                                 chunks_backing,
+                                                 retained_limit,
+                                                 counters);
+    }
+    return *pool;
+  }
+
+  auto pool = std::find_if(std::cbegin(pools),
+                           std::cend(pools),
+                           [size, alignment] (const auto& pool)
+                           {
+                             return pool->fits(size, alignment);
+                           });
+  if(std::cend(pools) != pool)
+    return **pool;
+
+  register_pool();
+  pools.push_back(std::make_unique<detail::slot_pool>(size, alignment, slots_count, pools_mode, chunks_growth, chunks_backing, retained_limit, counters));
+  return *pools.back();
+}
+
+std::size_t block_pool::slots_for(const detail::slot_pool& pool, std::size_t size, std::size_t n) const noexcept
+{
+  // Empty requests take a slot too, so every pointer handed out is distinct and counted.
+  const auto bytes = n * size;
+  return std::max<std::size_t>(1, bytes / pool.size() + ((0 != bytes % pool.size()) ? 1 : 0));
+}
+
+void* block_pool::allocate_large(std::size_t size, std::size_t alignment)
+{
+  register_pool();
+  counters.large_allocations.fetch_add(1, std::memory_order_relaxed);
+  auto p = (alignment > alignof(std::max_align_t)) ? homework3::aligned_malloc(alignment, size)
+                                                   : homework3::malloc(size);
+  if(!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void block_pool::deallocate_large(void* p) noexcept
+{
+  homework3::free(p);
+}
+
+void block_pool::do_trim() noexcept
+{
+  for(auto& pool : size_classes)
+    if(pool)
+      pool->trim();
+  for(auto& pool : pools)
+    pool->trim();
+}
+
+synchronized_block_pool::~synchronized_block_pool()
+{
+  for(std::size_t size_class = 0; size_class < size_classes_count; ++size_class)
+    release_deferred(size_class);
+}
+
+void* synchronized_block_pool::do_allocate_slots(std::size_t size, std::size_t alignment, std::size_t n)
+{
+  std::lock_guard<std::mutex> lock{mutex};
+  release_deferred(deferred_class(size, alignment, 1));
+  return block_pool::do_allocate_slots(size, alignment, n);
+}
+
+void synchronized_block_pool::do_allocate_slots_bulk(std::size_t size, std::size_t alignment, void** slots, std::size_t n)
+{
+  std::lock_guard<std::mutex> lock{mutex};
+  release_deferred(deferred_class(size, alignment, 1));
+  block_pool::do_allocate_slots_bulk(size, alignment, slots, n);
+}
+
+void synchronized_block_pool::do_deallocate_slots(void* p, std::size_t size, std::size_t alignment, std::size_t n) noexcept
+{
+  const auto size_class = deferred_class(size, alignment, n);
+  if(size_classes_count == size_class) {
+    std::lock_guard<std::mutex> lock{mutex};
+    block_pool::do_deallocate_slots(p, size, alignment, n);
+    return;
+  }
+
+  // Only the owner of the mutex takes the whole list at once, so a pushed slot is never
+  // popped from under a pushing thread and the list needs no ABA protection.
+  auto& head = deferred[size_class];
+  auto link = static_cast<void**>(p);
+  *link = head.load(std::memory_order_relaxed);
+  while(!head.compare_exchange_weak(*link, p, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void synchronized_block_pool::do_trim() noexcept
+{
+  std::lock_guard<std::mutex> lock{mutex};
+  for(std::size_t size_class = 0; size_class < size_classes_count; ++size_class)
+    release_deferred(size_class);
+  block_pool::do_trim();
+}
+
+std::size_t synchronized_block_pool::deferred_class(std::size_t size, std::size_t alignment, std::size_t n) const noexcept
+{
+  if((1 != n) || (slot_padding::none != padding()) || (size_class_granularity < alignment) || (largest_size_class < size))
+    return size_classes_count;
+  return (std::max(size, std::size_t{1}) - 1) / size_class_granularity;
+}
+
+void synchronized_block_pool::release_deferred(std::size_t size_class) noexcept
+{
+  if(size_classes_count == size_class)
+    return;
+  auto p = deferred[size_class].exchange(nullptr, std::memory_order_acquire);
+  while(nullptr != p) {
+    auto next = *static_cast<void**>(p);
+    block_pool::do_deallocate_slots(p, (size_class + 1) * size_class_granularity, size_class_granularity, 1);
+    p = next;
+  }
+}
+
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace homework3 {
+
+enum class allocation_mode {
+  free_list,  // free slots are threaded into an intrusive list, allocate/deallocate are O(1)
+  bitset      // occupancy of every block is kept in a bitset, used for debugging and validation
+};
+
+enum class slot_padding {
+  none,       // slots are as small as size and alignment allow
+  cache_line  // every slot starts at a cache line and takes whole cache lines, so slots never share them
+};
+
+enum class backing_store {
+  heap,       // chunks are allocated by malloc
+  pages,      // chunks are mapped by mmap, pages of spare blocks are given back to the kernel
+  huge_pages  // as pages, chunks are at least huge_page_size and advised to use transparent huge pages
+};
+
+// Number of blocks obtained by one call to malloc, given the number of such chunks a slot
+// pool already holds. Blocks keep one size and alignment whatever the policy is, only
+// chunks grow.
+using growth_policy = std::function<std::size_t(std::size_t chunks_count)>;
+
+// Every chunk holds the same number of blocks.
+growth_policy fixed_growth(std::size_t blocks_per_chunk = 1);
+
+// Every next chunk holds twice as many blocks as the previous one, up to max_blocks_per_chunk.
+growth_policy geometric_growth(std::size_t max_blocks_per_chunk);
+
+// Snapshot of the counters of a block_pool, or a sum of snapshots of several pools.
+struct pool_stats {
+  std::size_t live_slots{};         // slots handed out
+  std::size_t capacity_slots{};     // slots of blocks in use
+  std::size_t blocks{};             // blocks with at least one slot handed out
+  std::size_t spare_blocks{};       // empty blocks of allocated chunks
+  std::size_t chunks{};             // chunks obtained from the backing store
+  std::size_t peak_live_slots{};    // high-water mark of live_slots, a sum of pools' marks is an upper bound
+  std::size_t allocations{};        // calls served by blocks
+  std::size_t deallocations{};
+  std::size_t large_allocations{};  // calls that bypassed blocks
+  std::size_t scanned_blocks{};     // blocks inspected to serve allocations
+
+  // Share of capacity_slots that is not handed out.
+  double fragmentation() const noexcept;
+  // Blocks inspected per allocation.
+  double average_scan_length() const noexcept;
+
+  pool_stats& operator+=(const pool_stats& other) noexcept;
+};
+
+namespace detail {
+
+// Counter written by one thread at a time, read by any. The owner of the counter is the only
+// writer, so an update needs no read-modify-write and costs as much as a plain one.
+class relaxed_counter {
+
+public:
+
+  void add(std::size_t n) noexcept
+  {
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  void subtract(std::size_t n) noexcept
+  {
+    value.store(value.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+  }
+
+  void raise_to(std::size_t n) noexcept
+  {
+    if(value.load(std::memory_order_relaxed) < n)
+      value.store(n, std::memory_order_relaxed);
+  }
+
+  std::size_t load() const noexcept
+  {
+    return value.load(std::memory_order_relaxed);
+  }
+
+private:
+
+  std::atomic<std::size_t> value{0};
+};
+
+struct pool_counters {
+  relaxed_counter live_slots;
+  relaxed_counter capacity_slots;
+  relaxed_counter blocks;
+  relaxed_counter spare_blocks;
+  relaxed_counter chunks;
+  relaxed_counter peak_live_slots;
+  relaxed_counter allocations;
+  relaxed_counter deallocations;
+  relaxed_counter scanned_blocks;
+  // Large requests of synchronized_block_pool are served without the lock.
+  std::atomic<std::size_t> large_allocations{0};
+
+  pool_stats load() const noexcept;
+};
+
+// Blocks of slots of one size. Blocks are allocated at an alignment equal to their
+// power-of-two size, so the header of the block owning any slot is found by masking
+// the low bits of the slot address. Blocks with free slots are kept at the front of
+// the list, full blocks at the back. Blocks are carved out of chunks allocated according
+// to the growth policy from the backing store, an empty block is kept as spare until all
+// blocks of its chunk are empty. Then the chunk is released, unless it fits into the limit
+// of retained empty blocks, which saves malloc and free when usage oscillates around a
+// block boundary.
+class slot_pool {
+
+public:
+
+  static constexpr std::size_t huge_page_size = std::size_t{2} << 20;
+
+  slot_pool(std::size_t size, std::size_t alignment, std::size_t slots_per_block, allocation_mode mode,
+            const growth_policy& growth, backing_store backing, std::size_t retained_empty_blocks,
+            pool_counters& counters);
+  ~slot_pool();
+
+  slot_pool(const slot_pool&) = delete;
+  slot_pool& operator=(const slot_pool&) = delete;
+
+  bool fits(std::size_t size, std::size_t alignment) const noexcept;
+
+  std::size_t size() const noexcept
+  {
+    return slot_size;
+  }
+
+  // Returns n contiguous slots, n must not exceed slots_per_block.
+  void* allocate(std::size_t n);
+  void deallocate(void* p, std::size_t n) noexcept;
+  // Fills slots with n single slots, each to be deallocated on its own.
+  void allocate_bulk(void** slots, std::size_t n);
+
+  // Releases chunks retained while all their blocks are empty.
+  void trim() noexcept;
+
+private:
+
+  struct block_header;
+
+  block_header* owner_of(const void* p) const noexcept;
+  char* slots_of(block_header* block) const noexcept;
+  std::uint64_t* words_of(block_header* block) const noexcept;
+
+  void* allocate_from_free_list(std::size_t n);
+  void* allocate_from_bitset(std::size_t n);
+  bool find_run(block_header* block, std::size_t n, std::size_t& position) const noexcept;
+  void flip(block_header* block, std::size_t position, std::size_t n) const noexcept;
+
+  block_header* allocate_block();
+  block_header* allocate_chunk();
+  void init_block(block_header* block) const noexcept;
+  void release_block(block_header* block) noexcept;
+  void release_chunk(block_header* chunk) noexcept;
+  void push_spare(block_header* block) noexcept;
+  void unlink_spare(block_header* block) noexcept;
+  void move_to_front(block_header* block) noexcept;
+  void move_to_back(block_header* block) noexcept;
+  void link_front(block_header* block) noexcept;
+  void link_back(block_header* block) noexcept;
+  void unlink(block_header* block) noexcept;
+
+  const std::size_t requested_size;
+  const std::size_t slot_alignment;
+  const std::size_t slot_size;
+  const std::size_t slots_per_block;
+  const allocation_mode mode;
+  const std::size_t words_count;
+  const std::size_t slots_offset;
+  const std::size_t block_size;
+  const growth_policy growth;
+  const backing_store backing;
+  const std::size_t retained_limit;
+  pool_counters& counters;
+
+  block_header* first{nullptr};
+  block_header* last{nullptr};
+  block_header* spare{nullptr};
+  std::size_t chunks_count{};
+  std::size_t retained_blocks{};
+};
+
+}
+
+// Set of slot pools shared by custom_allocator handles, so copies and rebinds of an
+// allocator use the same blocks. Requests of up to largest_size_class bytes with an
+// alignment of at most size_class_granularity are rounded up to a multiple of
+// size_class_granularity, so types of close sizes share slots of one size class.
+// Every other size and alignment gets a slot pool of its own. With slot_padding::cache_line
+// every request is aligned to at least cache_line_size.
+// As a memory_resource it serves std::pmr containers, requests of one slot up to
+// largest_pooled_size bytes go to the slot pools, larger ones straight to malloc.
+// Not thread-safe, see synchronized_block_pool.
+class block_pool : public std::pmr::memory_resource {
+
+public:
+
+  static constexpr std::size_t size_class_granularity = 16;
+  static constexpr std::size_t largest_size_class = 256;
+  static constexpr std::size_t default_largest_pooled_size = largest_size_class;
+  static constexpr std::size_t cache_line_size = 64;
+
+  explicit block_pool(std::size_t slots_per_block,
+                      allocation_mode mode = allocation_mode::free_list,
+                      std::size_t largest_pooled_size = default_largest_pooled_size,
+                      growth_policy growth = fixed_growth(),
+                      slot_padding padding = slot_padding::none,
+                      backing_store backing = backing_store::heap,
+                      std::size_t retained_empty_blocks = 0);
+
+  ~block_pool();
+
+  block_pool(const block_pool&) = delete;
+  block_pool& operator=(const block_pool&) = delete;
+
+  std::size_t slots_per_block() const noexcept
+  {
+    return slots_count;
+  }
+
+  allocation_mode mode() const noexcept
+  {
+    return pools_mode;
+  }
+
+  std::size_t largest_pooled_size() const noexcept
+  {
+    return largest_pooled;
+  }
+
+  const growth_policy& growth() const noexcept
+  {
+    return chunks_growth;
+  }
+
+  slot_padding padding() const noexcept
+  {
+    return slots_padding;
+  }
+
+  backing_store backing() const noexcept
+  {
+    return chunks_backing;
+  }
+
+  std::size_t retained_empty_blocks() const noexcept
+  {
+    return retained_limit;
+  }
+
+  // Counters are read with relaxed loads, so a snapshot may be taken from any thread while
+  // the pool is in use, though counters of the snapshot may be from slightly different moments.
+  pool_stats stats() const noexcept
+  {
+    return counters.load();
+  }
+
+  // Sum of stats of all existing pools and of cumulative counters of destroyed ones.
+  static pool_stats global_stats() noexcept;
+
+  // Releases retained empty blocks of every slot pool.
+  void trim() noexcept
+  {
+    do_trim();
+  }
+
+  // Returns storage for n contiguous elements of the given size, packed into as few slots
+  // as cover them. Requests for more than slots_per_block elements bypass the blocks.
+  void* allocate_slots(std::size_t size, std::size_t alignment, std::size_t n)
+  {
+    return do_allocate_slots(size, alignment, n);
+  }
+
+  void deallocate_slots(void* p, std::size_t size, std::size_t alignment, std::size_t n) noexcept
+  {
+    do_deallocate_slots(p, size, alignment, n);
+  }
+
+  // Fills slots with storage for n single elements of the given size, taken from blocks as
+  // many at once as every block has free. Each element is deallocated on its own, as
+  // allocated by allocate_slots(size, alignment, 1).
+  void allocate_slots_bulk(std::size_t size, std::size_t alignment, void** slots, std::size_t n)
+  {
+    do_allocate_slots_bulk(size, alignment, slots, n);
+  }
+
+protected:
+
+  virtual void* do_allocate_slots(std::size_t size, std::size_t alignment, std::size_t n);
+  virtual void do_deallocate_slots(void* p, std::size_t size, std::size_t alignment, std::size_t n) noexcept;
+  virtual void do_allocate_slots_bulk(std::size_t size, std::size_t alignment, void** slots, std::size_t n);
+  virtual void do_trim() noexcept;
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+
+  detail::slot_pool& pool_for(std::size_t size, std::size_t alignment);
+  std::size_t slots_for(const detail::slot_pool& pool, std::size_t size, std::size_t n) const noexcept;
+
+  void* allocate_large(std::size_t size, std::size_t alignment);
+  static void deallocate_large(void* p) noexcept;
+
+  // Pools are linked into a list, which is not allocated, so creation of a pool is not seen
+  // by alloc_counter(). A pool joins the list on its first slot pool or large request, so
+  // pools that never allocate take no process-wide lock.
+  void register_pool() noexcept;
+  static std::mutex& registry_mutex() noexcept;
+  static block_pool*& registry() noexcept;
+  static pool_stats& retired_stats() noexcept;
+
+  const std::size_t slots_count;
+  const allocation_mode pools_mode;
+  const std::size_t largest_pooled;
+  const growth_policy chunks_growth;
+  const slot_padding slots_padding;
+  const backing_store chunks_backing;
+  const std::size_t retained_limit;
+  detail::pool_counters counters;
+  std::atomic<bool> registered{false};
+  block_pool* prev_pool{nullptr};
+  block_pool* next_pool{nullptr};
+  std::array<std::unique_ptr<detail::slot_pool>, largest_size_class / size_class_granularity> size_classes;
+  std::vector<std::unique_ptr<detail::slot_pool>> pools;
+};
+
+// block_pool that may be used from several threads at once. Allocations are served under
+// a mutex. Single slots of size classes are freed without it: they are pushed to a lock-free
+// list of their size class and given back to the blocks under the mutex by the next
+// allocation from that class or by trim(), so stats() counts them as live until then.
+// Other deallocations take the mutex.
+class synchronized_block_pool : public block_pool {
+
+public:
+
+  using block_pool::block_pool;
+
+  ~synchronized_block_pool();
+
+protected:
+
+  void* do_allocate_slots(std::size_t size, std::size_t alignment, std::size_t n) override;
+  void do_deallocate_slots(void* p, std::size_t size, std::size_t alignment, std::size_t n) noexcept override;
+  void do_allocate_slots_bulk(std::size_t size, std::size_t alignment, void** slots, std::size_t n) override;
+  void do_trim() noexcept override;
+
+private:
+
+  static constexpr std::size_t size_classes_count = largest_size_class / size_class_granularity;
+
+  // Index of the size class whose single slots are freed without the mutex, or size_classes_count.
+  std::size_t deferred_class(std::size_t size, std::size_t alignment, std::size_t n) const noexcept;
+  void release_deferred(std::size_t size_class) noexcept;
+
+  std::mutex mutex;
+  std::array<std::atomic<void*>, size_classes_count> deferred{};
+};
+
+}
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include "newdelete.h"
+
+namespace homework3 {
+
+namespace detail {
+
+template<typename T>
+using slot_storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+// Free slot kept by a thread cache or by a depot. Slots moved to the depot at once stay
+// chained by next, the first slot of every such batch links the next batch. Slots have room
+// for the two links only, so the length of a batch is counted when a cache takes it.
+struct cached_slot {
+  cached_slot* next;
+  cached_slot* next_batch;
+};
+
+// Free slots owned by one thread. The depot is touched only when the cache is empty,
+// or when it holds twice ALLOC_AT_ONCE_COUNT slots and half of them is given back.
+template<typename Depot,
+        std::size_t ALLOC_AT_ONCE_COUNT>
+class thread_cache {
+
+public:
+
+  explicit thread_cache(Depot& _depot)
+    : depot(_depot) {}
+
+  thread_cache(const thread_cache&) = delete;
+  thread_cache& operator=(const thread_cache&) = delete;
+
+  // Slots are taken from the cache of the calling thread. Once that cache is destroyed at
+  // thread exit, e.g. by a static container released after thread_local objects, single
+  // slots go to and from the depot directly, which is never destroyed. Returns nullptr
+  // when the depot has no slots and gets no more blocks.
+  static void* allocate()
+  {
+    if(destroyed)
+      return pop_single(Depot::instance());
+    return local().pop();
+  }
+
+  static void deallocate(void* p) noexcept
+  {
+    if(destroyed)
+      push_single(Depot::instance(), p);
+    else
+      local().push(p);
+  }
+
+  ~thread_cache()
+  {
+    destroyed = true;
+    if(nullptr != slots)
+      depot.push_batch(slots);
+  }
+
+  void* pop()
+  {
+    if(nullptr == slots) {
+      slots = depot.pop_batch();
+      if(nullptr == slots)
+        return nullptr;
+      for(auto slot = slots; nullptr != slot; slot = slot->next)
+        ++count;
+    }
+    auto p = slots;
+    slots = slots->next;
+    --count;
+    return p;
+  }
+
+  void push(void* p) noexcept
+  {
+    auto released_slot = static_cast<cached_slot*>(p);
+    released_slot->next = slots;
+    slots = released_slot;
+    if(2 * ALLOC_AT_ONCE_COUNT == ++count)
+      give_back_batch();
+  }
+
+private:
+
+  static thread_cache& local()
+  {
+    static thread_local thread_cache cache{Depot::instance()};
+    return cache;
+  }
+
+  static void* pop_single(Depot& depot)
+  {
+    auto batch = depot.pop_batch();
+    if(nullptr != batch && nullptr != batch->next)
+      depot.push_batch(batch->next);
+    return batch;
+  }
+
+  static void push_single(Depot& depot, void* p) noexcept
+  {
+    auto released_slot = static_cast<cached_slot*>(p);
+    released_slot->next = nullptr;
+    depot.push_batch(released_slot);
+  }
+
+  void give_back_batch() noexcept
+  {
+    auto batch = slots;
+    auto last = slots;
+    for(std::size_t i = 1; i < ALLOC_AT_ONCE_COUNT; ++i)
+      last = last->next;
+    slots = last->next;
+    last->next = nullptr;
+    count -= ALLOC_AT_ONCE_COUNT;
+    depot.push_batch(batch);
+  }
+
+  // Trivially destructible, so it is still readable after the cache is destroyed.
+  inline static thread_local bool destroyed{false};
+
+  Depot& depot;
+  cached_slot* slots{nullptr};
+  std::size_t count{};
+};
+
+// Constructed on first use and never destroyed, so it stays usable by containers
+// released by static destructors in any order.
+template<typename Depot>
+Depot& leaked_instance()
+{
+  static typename std::aligned_storage<sizeof(Depot), alignof(Depot)>::type storage;
+  static auto depot = new(&storage) Depot;
+  return *depot;
+}
+
+}
+
+// Shared by all threads, keeps blocks of ALLOC_AT_ONCE_COUNT slots of the same size.
+// The shared instance is never destroyed, blocks of other depots are returned to malloc
+// by the destructor.
+template<std::size_t SLOT_SIZE,
+        std::size_t ALLOC_AT_ONCE_COUNT>
+class locked_depot {
+
+  using cached_slot = detail::cached_slot;
+
+public:
+
+  locked_depot() = default;
+  locked_depot(const locked_depot&) = delete;
+  locked_depot& operator=(const locked_depot&) = delete;
+
+  static locked_depot& instance()
+  {
+    return detail::leaked_instance<locked_depot>();
+  }
+
+  ~locked_depot()
+  {
+    for(auto block : blocks)
+      homework3::free(block);
+  }
+
+  cached_slot* pop_batch()
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    if(nullptr == batches)
+      return allocate_block();
+    auto batch = batches;
+    batches = batch->next_batch;
+    return batch;
+  }
+
+  void push_batch(cached_slot* batch) noexcept
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    batch->next_batch = batches;
+    batches = batch;
+  }
+
+private:
+
+  cached_slot* allocate_block()
+  {
+    blocks.reserve(blocks.size() + 1);
+    auto p = homework3::malloc(ALLOC_AT_ONCE_COUNT * SLOT_SIZE);
+    if(!p)
+      throw std::bad_alloc();
+    blocks.push_back(p);
+
+    auto block = reinterpret_cast<char*>(p);
+    for(std::size_t i = 0; i < ALLOC_AT_ONCE_COUNT - 1; ++i)
+      reinterpret_cast<cached_slot*>(block + i * SLOT_SIZE)->next = reinterpret_cast<cached_slot*>(block + (i + 1) * SLOT_SIZE);
+    reinterpret_cast<cached_slot*>(block + (ALLOC_AT_ONCE_COUNT - 1) * SLOT_SIZE)->next = nullptr;
+    return reinterpret_cast<cached_slot*>(block);
+  }
+
+  std::mutex mutex;
+  cached_slot* batches{nullptr};
+  std::vector<void*> blocks;
+};
+
+// Blocks of lockfree_depot, allocated by malloc and freed together with the source.
+class heap_block_source {
+
+  // Every block starts with a link to the previously allocated block.
+  static constexpr std::size_t block_header_size = alignof(std::max_align_t);
+
+public:
+
+  heap_block_source() = default;
+  heap_block_source(const heap_block_source&) = delete;
+  heap_block_source& operator=(const heap_block_source&) = delete;
+
+  ~heap_block_source()
+  {
+    auto block = blocks.load(std::memory_order_acquire);
+    while(nullptr != block) {
+      auto next = *static_cast<void**>(block);
+      homework3::free(block);
+      block = next;
+    }
+  }
+
+  void* allocate(std::size_t size)
+  {
+    auto p = homework3::malloc(block_header_size + size);
+    if(!p)
+      throw std::bad_alloc();
+    auto link = static_cast<void**>(p);
+    *link = blocks.load(std::memory_order_relaxed);
+    while(!blocks.compare_exchange_weak(*link, p, std::memory_order_release, std::memory_order_relaxed));
+    return static_cast<char*>(p) + block_header_size;
+  }
+
+private:
+
+  std::atomic<void*> blocks{nullptr};
+};
+
+// Lock-free alternative to locked_depot. Batches are kept in a Treiber stack, the top of
+// the stack carries a 16-bit tag in the upper bits of the pointer, which is incremented by
+// every change and so protects from ABA. Blocks of ALLOC_AT_ONCE_COUNT slots are taken from
+// the Source, whose allocate(size) returns nullptr or throws when it has no more. Slots are
+// never returned to the Source before the depot is destroyed, so the link of a batch popped
+// concurrently by another thread stays readable.
+// Pointers are assumed to fit into 48 bits, as on x86-64 and AArch64.
+template<std::size_t SLOT_SIZE,
+        std::size_t ALLOC_AT_ONCE_COUNT,
+        typename Source>
+class basic_lockfree_depot {
+
+  using cached_slot = detail::cached_slot;
+
+  static_assert(8 == sizeof(std::uintptr_t), "lockfree_depot requires 64-bit pointers.");
+  static_assert(sizeof(cached_slot) <= SLOT_SIZE, "Slots must have room for two links.");
+
+  static constexpr std::uintptr_t pointer_mask = (std::uintptr_t{1} << 48) - 1;
+  static constexpr std::uintptr_t tag_unit = std::uintptr_t{1} << 48;
+
+public:
+
+  basic_lockfree_depot() = default;
+  basic_lockfree_depot(const basic_lockfree_depot&) = delete;
+  basic_lockfree_depot& operator=(const basic_lockfree_depot&) = delete;
+
+  static basic_lockfree_depot& instance()
+  {
+    return detail::leaked_instance<basic_lockfree_depot>();
+  }
+
+  // Returns nullptr when the depot is empty and the Source has no more blocks.
+  cached_slot* pop_batch()
+  {
+    auto top = batches.load(std::memory_order_acquire);
+    while(true) {
+      auto batch = reinterpret_cast<cached_slot*>(top & pointer_mask);
+      if(nullptr == batch)
+        return allocate_block();
+      auto next = __atomic_load_n(&batch->next_batch, __ATOMIC_RELAXED);
+      if(batches.compare_exchange_weak(top,
+                                       reinterpret_cast<std::uintptr_t>(next) | ((top & ~pointer_mask) + tag_unit),
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire))
+        return batch;
+    }
+  }
+
+  void push_batch(cached_slot* batch) noexcept
+  {
+    auto top = batches.load(std::memory_order_relaxed);
+    do {
+      __atomic_store_n(&batch->next_batch, reinterpret_cast<cached_slot*>(top & pointer_mask), __ATOMIC_RELAXED);
+    } while(!batches.compare_exchange_weak(top,
+                                           reinterpret_cast<std::uintptr_t>(batch) | ((top & ~pointer_mask) + tag_unit),
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+  }
+
+private:
+
+  cached_slot* allocate_block()
+  {
+    auto block = static_cast<char*>(source.allocate(ALLOC_AT_ONCE_COUNT * SLOT_SIZE));
+    if(nullptr == block)
+      return nullptr;
+    for(std::size_t i = 0; i < ALLOC_AT_ONCE_COUNT - 1; ++i)
+      reinterpret_cast<cached_slot*>(block + i * SLOT_SIZE)->next = reinterpret_cast<cached_slot*>(block + (i + 1) * SLOT_SIZE);
+    reinterpret_cast<cached_slot*>(block + (ALLOC_AT_ONCE_COUNT - 1) * SLOT_SIZE)->next = nullptr;
+    return reinterpret_cast<cached_slot*>(block);
+  }
+
+  std::atomic<std::uintptr_t> batches{0};
+  Source source;
+};
+
+template<std::size_t SLOT_SIZE,
+        std::size_t ALLOC_AT_ONCE_COUNT>
+using lockfree_depot = basic_lockfree_depot<SLOT_SIZE, ALLOC_AT_ONCE_COUNT, heap_block_source>;
+
+// Thread-safe counterpart of custom_allocator. Allocators of the same slot size share one
+// depot, every thread allocates from and deallocates to its own cache of free slots, so
+// memory may be allocated on one thread and deallocated on another. Only single elements
+// are pooled, requests for more go straight to malloc. The depot is either locked_depot
+// or lockfree_depot. Types aligned beyond max_align_t are rejected at compile time.
+template<typename T,
+        std::size_t ALLOC_AT_ONCE_COUNT,
+        template<std::size_t, std::size_t> class Depot = locked_depot>
+class concurrent_allocator {
+
+  static_assert(0 != ALLOC_AT_ONCE_COUNT, "2nd template parameter must be not equal to 0.");
+  // Blocks of the depots are allocated by malloc, which aligns them to max_align_t only.
+  static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported.");
+
+  union slot {
+    detail::cached_slot links;
+    detail::slot_storage<T> storage;
+  };
+
+  using depot_type = Depot<sizeof(slot), ALLOC_AT_ONCE_COUNT>;
+  using cache_type = detail::thread_cache<depot_type, ALLOC_AT_ONCE_COUNT>;
+
+public:
+
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using is_always_equal = std::true_type;
+
+  template<typename U> struct rebind { typedef concurrent_allocator<U, ALLOC_AT_ONCE_COUNT, Depot> other; };
+
+  concurrent_allocator() = default;
+
+  template<typename U>
+  concurrent_allocator(const concurrent_allocator<U, ALLOC_AT_ONCE_COUNT, Depot>&) noexcept {}
+
+  pointer allocate(std::size_t n) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+
+    if(1 == n) {
+      auto p = cache_type::allocate();
+      if(!p)
+        throw std::bad_alloc();
+      return static_cast<pointer>(p);
+    }
+
+    if(std::numeric_limits<std::size_t>::max() / sizeof(T) < n)
+      throw std::bad_alloc();
+    auto p = homework3::malloc(n * sizeof(T));
+    if(!p)
+      throw std::bad_alloc();
+    return static_cast<pointer>(p);
+  }
+
+  void deallocate(pointer p, std::size_t n) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+
+    if(1 == n)
+      cache_type::deallocate(p);
+    else
+      homework3::free(p);
+  }
+
+  template<typename ... Args >
+  void construct(pointer p, Args&&... args) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+    new(p) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(pointer p) {
+    //std::cout << __PRETTY_FUNCTION__ << std::endl;
+    p->~T();
+  }
+};
+
+template<typename T, typename U, std::size_t ALLOC_AT_ONCE_COUNT, template<std::size_t, std::size_t> class Depot>
+bool operator==(const concurrent_allocator<T, ALLOC_AT_ONCE_COUNT, Depot>&, const concurrent_allocator<U, ALLOC_AT_ONCE_COUNT, Depot>&) noexcept
+{
+  return true;
+}
+
+template<typename T, typename U, std::size_t ALLOC_AT_ONCE_COUNT, template<std::size_t, std::size_t> class Depot>
+bool operator!=(const concurrent_allocator<T, ALLOC_AT_ONCE_COUNT, Depot>& lhs, const concurrent_allocator<U, ALLOC_AT_ONCE_COUNT, Depot>& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
+}
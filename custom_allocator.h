@@ -1,21 +1,25 @@
 #pragma once
 
 #include <cstddef>
-#include <algorithm>
-#include <list>
-#include <bitset>
-#include <stdexcept>
 #include <memory>
-#include "newdelete.h"
+#include <type_traits>
+#include "block_pool.h"
 
 namespace homework3 {
 
+// Handle to a reference-counted block_pool. Copies and rebinds share the pool and
+// compare equal, the pool is released together with the last handle. The pool may be
+// a synchronized_block_pool, then the handles may be used from several threads, and single
+// elements are deallocated without taking its mutex.
 template<typename T,
-        std::size_t ALLOC_AT_ONCE_COUNT>
+        std::size_t ALLOC_AT_ONCE_COUNT,
+        allocation_mode MODE = allocation_mode::free_list>
 class custom_allocator {
 
   static_assert(0 != ALLOC_AT_ONCE_COUNT, "2nd template parameter must be not equal to 0.");
 
+  template<typename, std::size_t, allocation_mode> friend class custom_allocator;
+
 public:
 
   using value_type = T;
@@ -26,66 +30,67 @@ public:
   using size_type = std::size_t;
   using difference_type = std::ptrdiff_t;
 
-  template<typename U> struct rebind { typedef custom_allocator<U, ALLOC_AT_ONCE_COUNT> other; };
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  template<typename U> struct rebind { typedef custom_allocator<U, ALLOC_AT_ONCE_COUNT, MODE> other; };
+
+  custom_allocator()
+    : pool{std::make_shared<block_pool>(ALLOC_AT_ONCE_COUNT, MODE)} {}
+
+  // Blocks of ALLOC_AT_ONCE_COUNT elements are allocated in chunks sized by the growth policy,
+  // up to retained_empty_blocks empty blocks are kept until get_pool()->trim().
+  explicit custom_allocator(growth_policy growth, std::size_t retained_empty_blocks = 0)
+    : pool{std::make_shared<block_pool>(ALLOC_AT_ONCE_COUNT, MODE, block_pool::default_largest_pooled_size, std::move(growth),
+                                        slot_padding::none, backing_store::heap, retained_empty_blocks)} {}
+
+  // With slot_padding::cache_line elements of different slots never share a cache line.
+  explicit custom_allocator(slot_padding padding, growth_policy growth = fixed_growth())
+    : pool{std::make_shared<block_pool>(ALLOC_AT_ONCE_COUNT, MODE, block_pool::default_largest_pooled_size, std::move(growth), padding)} {}
+
+  // Chunks of blocks are mapped from the kernel rather than allocated by malloc.
+  explicit custom_allocator(backing_store backing, growth_policy growth = fixed_growth())
+    : pool{std::make_shared<block_pool>(ALLOC_AT_ONCE_COUNT, MODE, block_pool::default_largest_pooled_size, std::move(growth), slot_padding::none, backing)} {}
+
+  // A moved-from allocator must still compare equal to the new one, so moves copy the handle.
+  custom_allocator(const custom_allocator&) = default;
+  custom_allocator& operator=(const custom_allocator&) = default;
+
+  explicit custom_allocator(std::shared_ptr<block_pool> _pool) noexcept
+    : pool{std::move(_pool)} {}
 
-  custom_allocator() = default;
+  template<typename U>
+  custom_allocator(const custom_allocator<U, ALLOC_AT_ONCE_COUNT, MODE>& other) noexcept
+    : pool{other.pool} {}
+
+  const std::shared_ptr<block_pool>& get_pool() const noexcept {
+    return pool;
+  }
 
   pointer allocate(std::size_t n ) {
     //std::cout << __PRETTY_FUNCTION__ << std::endl;
 
-    if(1 != n)
-      throw std::invalid_argument("custom_allocator can allocate only 1 element by call");
-
-    std::size_t position{};
-    auto not_full_block = std::find_if (std::begin(allocated_blocks),
-                                        std::end(allocated_blocks),
-                                        [&position] (const auto& block_description)
-                                        {
-                                          if(block_description.second.all())
-                                            return false;
-                                          
-                                          for(position = 0; position < block_description.second.size(); ++position) {
-                                            if(!block_description.second[position])
-                                              return true;
-                                          }
-                                          return false;
-                                        });
-
-    if(std::end(allocated_blocks) == not_full_block) {
-      auto p = homework3::malloc( ALLOC_AT_ONCE_COUNT * sizeof(T) );
-      if(!p)
-        throw std::bad_alloc();
-      allocated_blocks.push_back(std::make_pair(std::unique_ptr<void, decltype(&std::free)>(p, homework3::free),
-                                                std::bitset<ALLOC_AT_ONCE_COUNT>{1}));
-      return reinterpret_cast<pointer>(allocated_blocks.back().first.get());
-    }
-
-    not_full_block->second[position] = 1;
-    return reinterpret_cast<pointer>(not_full_block->first.get()) + position;
+    return static_cast<pointer>(pool->allocate_slots(sizeof(T), alignof(T), n));
+  }
+
+  // Fills p with n pointers to single elements, each to be released by deallocate(p[i], 1).
+  // Elements come from blocks as many at once as every block has free.
+  void allocate_bulk(pointer* p, std::size_t n) {
+    pool->allocate_slots_bulk(sizeof(T), alignof(T), reinterpret_cast<void**>(p), n);
   }
 
   void deallocate(pointer p, std::size_t n) {
     //std::cout << __PRETTY_FUNCTION__ << std::endl;
 
-    auto allocated_block = std::find_if (std::begin(allocated_blocks),
-                                         std::end(allocated_blocks),
-                                         [p] (const auto& block_description)
-                                         {
-                                          return ((p >= reinterpret_cast<pointer>(block_description.first.get()))
-                                                  && (p <= reinterpret_cast<pointer>(block_description.first.get()) + block_description.second.size() - 1));
-                                         });
-    if(std::end(allocated_blocks) == allocated_block)
-      return;
-    allocated_block->second[p - reinterpret_cast<pointer>(allocated_block->first.get())] = 0;
-    if(allocated_block->second.none()) {
-      allocated_blocks.erase(allocated_block);
-    }
+    pool->deallocate_slots(p, sizeof(T), alignof(T), n);
   }
 
   template<typename ... Args >
   void construct(pointer p, Args&&... args) {
     //std::cout << __PRETTY_FUNCTION__ << std::endl;
-    new(p) T{std::forward<Args>(args)...};
+    new(p) T(std::forward<Args>(args)...);
   }
 
   void destroy(pointer p) {
@@ -95,7 +100,19 @@ public:
 
 private:
 
-  std::list<std::pair<std::unique_ptr<void, decltype(&std::free)>, std::bitset<ALLOC_AT_ONCE_COUNT>>> allocated_blocks;
+  std::shared_ptr<block_pool> pool;
 };
 
+template<typename T, typename U, std::size_t ALLOC_AT_ONCE_COUNT, allocation_mode MODE>
+bool operator==(const custom_allocator<T, ALLOC_AT_ONCE_COUNT, MODE>& lhs, const custom_allocator<U, ALLOC_AT_ONCE_COUNT, MODE>& rhs) noexcept
+{
+  return lhs.get_pool() == rhs.get_pool();
+}
+
+template<typename T, typename U, std::size_t ALLOC_AT_ONCE_COUNT, allocation_mode MODE>
+bool operator!=(const custom_allocator<T, ALLOC_AT_ONCE_COUNT, MODE>& lhs, const custom_allocator<U, ALLOC_AT_ONCE_COUNT, MODE>& rhs) noexcept
+{
+  return !(lhs == rhs);
+}
+
 }
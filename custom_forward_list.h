@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <type_traits>
 
 namespace homework3 {
@@ -15,7 +19,7 @@ struct c_fwd_list_node : c_fwd_list_node_base
 {
   template<typename ... Args>
   c_fwd_list_node(Args&& ... args)
-    : c_fwd_list_node_base{}, value{std::forward<Args>(args)...} {}
+    : c_fwd_list_node_base{}, value(std::forward<Args>(args)...) {}
 
   T value;
 };
@@ -88,6 +92,9 @@ struct c_fwd_list_const_iterator
   explicit c_fwd_list_const_iterator(const c_fwd_list_node_base* _node)
     : node{_node} {}
 
+  c_fwd_list_const_iterator(const c_fwd_list_iterator<T>& other)
+    : node{other.node} {}
+
   reference operator*() const
   {
     return static_cast<Node*>(node)->value;
@@ -126,6 +133,20 @@ bool operator!=(const c_fwd_list_const_iterator<T>& lhs, const c_fwd_list_const_
   return lhs.node != rhs.node;
 }
 
+// Allocators with allocate_bulk(pointer*, n), such as custom_allocator, give storage for
+// many nodes in one call.
+template<typename Allocator, typename Pointer, typename = void>
+struct has_allocate_bulk : std::false_type {};
+
+template<typename Allocator, typename Pointer>
+struct has_allocate_bulk<Allocator, Pointer,
+                         std::void_t<decltype(std::declval<Allocator&>().allocate_bulk(std::declval<Pointer*>(), std::size_t{}))>>
+  : std::true_type {};
+
+template<typename InputIt>
+using enable_if_input_iterator = std::enable_if_t<std::is_base_of<std::input_iterator_tag,
+                                                                  typename std::iterator_traits<InputIt>::iterator_category>::value>;
+
 template<typename T, typename Allocator = std::allocator<T>>
 class custom_forward_list
 {
@@ -150,9 +171,35 @@ public:
 
   custom_forward_list() = default;
 
+  explicit custom_forward_list(const Allocator& _allocator)
+    : allocator{_allocator} {}
+
+  template<typename InputIt, typename = enable_if_input_iterator<InputIt>>
+  custom_forward_list(InputIt first, InputIt last, const Allocator& _allocator = Allocator())
+    : allocator{_allocator}
+  {
+    // The destructor is not run for a constructor that throws, so the elements already linked are freed here.
+    try {
+      insert_after(cbefore_begin(), first, last);
+    }
+    catch(...) {
+      clear();
+      throw;
+    }
+  }
+
+  // The copy shares the allocator of other where the allocator says so, e.g. the block_pool
+  // of custom_allocator, so nodes may be spliced or merged between the two lists.
   custom_forward_list(const custom_forward_list& other)
+    : allocator{std::allocator_traits<Allocator_Node>::select_on_container_copy_construction(other.allocator)}
   {
-    copy(std::cbegin(other), std::cend(other));
+    try {
+      copy(std::cbegin(other), std::cend(other));
+    }
+    catch(...) {
+      clear();
+      throw;
+    }
   }
 
   custom_forward_list(custom_forward_list&& other)
@@ -160,6 +207,8 @@ public:
   {
     head.next = other.head.next;
     other.head.next = nullptr;
+    count = other.count;
+    other.count = 0;
   }
 
   ~custom_forward_list()
@@ -169,8 +218,13 @@ public:
 
   custom_forward_list& operator=(const custom_forward_list& other)
   {
-    clear();
-    copy(std::cbegin(other), std::cend(other));
+    if(this != &other) {
+      clear();
+      if constexpr(std::allocator_traits<Allocator_Node>::propagate_on_container_copy_assignment::value)
+        allocator = other.allocator;
+      copy(std::cbegin(other), std::cend(other));
+    }
+    return *this;
   }
 
   custom_forward_list& operator=(custom_forward_list&& other)
@@ -178,7 +232,10 @@ public:
     clear();
     head.next = other.head.next;
     other.head.next = nullptr;
+    count = other.count;
+    other.count = 0;
     allocator = std::move(other.allocator);
+    return *this;
   }
 
   bool operator==(const custom_forward_list& other) const
@@ -200,26 +257,128 @@ public:
 
   void push_front(const T& value)
   {
-    Node* node = allocator.allocate(1);
-    allocator.construct(node, value);
-    node->next = head.next;
-    head.next = node;
+    emplace_front(value);
   }
 
   void push_front(T&& value)
   {
-    Node* node = allocator.allocate(1);
-    allocator.construct(node, std::forward<T>(value));
-    node->next = head.next;
-    head.next = node;
+    emplace_front(std::move(value));
+  }
+
+  template<typename ... Args>
+  reference emplace_front(Args&& ... args)
+  {
+    return *emplace_after(cbefore_begin(), std::forward<Args>(args)...);
   }
 
   void pop_front()
   {
-    Node* node = static_cast<Node*>(head.next);
-    head.next = node->next;
-    allocator.destroy(node);
-    allocator.deallocate(node, 1);
+    erase_after(cbefore_begin());
+  }
+
+  template<typename ... Args>
+  iterator emplace_after(const_iterator pos, Args&& ... args)
+  {
+    return link_after(pos, create_node(std::forward<Args>(args)...));
+  }
+
+  iterator insert_after(const_iterator pos, const T& value)
+  {
+    return emplace_after(pos, value);
+  }
+
+  iterator insert_after(const_iterator pos, T&& value)
+  {
+    return emplace_after(pos, std::move(value));
+  }
+
+  // Returns the iterator to the last inserted element, or pos if the range is empty.
+  template<typename InputIt, typename = enable_if_input_iterator<InputIt>>
+  iterator insert_after(const_iterator pos, InputIt first, InputIt last)
+  {
+    return iterator{link_range_after(mutable_node(pos), first, last)};
+  }
+
+  template<typename InputIt, typename = enable_if_input_iterator<InputIt>>
+  void assign(InputIt first, InputIt last)
+  {
+    clear();
+    insert_after(cbefore_begin(), first, last);
+  }
+
+  // Returns the iterator to the element following the erased one.
+  iterator erase_after(const_iterator pos)
+  {
+    auto prev = mutable_node(pos);
+    Node* node = static_cast<Node*>(prev->next);
+    prev->next = node->next;
+    destroy_node(node);
+    --count;
+    return iterator{prev->next};
+  }
+
+  // Erases the elements in (first, last).
+  iterator erase_after(const_iterator first, const_iterator last)
+  {
+    while(first.node->next != last.node)
+      erase_after(first);
+    return iterator{mutable_node(last)};
+  }
+
+  // Splices relink nodes without allocation, so allocators of both lists must compare equal.
+  // Moves all elements of other after pos.
+  void splice_after(const_iterator pos, custom_forward_list& other)
+  {
+    if(nullptr == other.head.next)
+      return;
+    auto other_last = &other.head;
+    while(nullptr != other_last->next)
+      other_last = other_last->next;
+    relink_after(pos, &other.head, other_last);
+    count += other.count;
+    other.count = 0;
+  }
+
+  void splice_after(const_iterator pos, custom_forward_list&& other)
+  {
+    splice_after(pos, other);
+  }
+
+  // Moves the element following it of other after pos.
+  void splice_after(const_iterator pos, custom_forward_list& other, const_iterator it)
+  {
+    auto node = it.node->next;
+    if(pos.node == it.node || pos.node == node)
+      return;
+    relink_after(pos, mutable_node(it), node);
+    ++count;
+    --other.count;
+  }
+
+  void splice_after(const_iterator pos, custom_forward_list&& other, const_iterator it)
+  {
+    splice_after(pos, other, it);
+  }
+
+  // Moves the elements in (first, last) of other after pos.
+  void splice_after(const_iterator pos, custom_forward_list& other, const_iterator first, const_iterator last)
+  {
+    auto before_last = mutable_node(first);
+    size_type moved{0};
+    while(before_last->next != last.node) {
+      before_last = before_last->next;
+      ++moved;
+    }
+    if(0 == moved)
+      return;
+    relink_after(pos, mutable_node(first), before_last);
+    count += moved;
+    other.count -= moved;
+  }
+
+  void splice_after(const_iterator pos, custom_forward_list&& other, const_iterator first, const_iterator last)
+  {
+    splice_after(pos, other, first, last);
   }
 
   reference front()
@@ -241,7 +400,7 @@ public:
 
   size_type size() const noexcept
   {
-    return std::distance(std::cbegin(*this), std::cend(*this));
+    return count;
   }
 
   void clear() noexcept
@@ -250,6 +409,131 @@ public:
       pop_front();
   }
 
+  // Operations below relink nodes and never allocate. Merges and sort are stable.
+  // Merges the sorted other into this sorted list, allocators must compare equal.
+  void merge(custom_forward_list& other)
+  {
+    merge(other, std::less<T>{});
+  }
+
+  void merge(custom_forward_list&& other)
+  {
+    merge(other);
+  }
+
+  template<typename Compare>
+  void merge(custom_forward_list& other, Compare comp)
+  {
+    if(this == &other)
+      return;
+    head.next = merge_chains(head.next, other.head.next, comp);
+    other.head.next = nullptr;
+    count += other.count;
+    other.count = 0;
+  }
+
+  template<typename Compare>
+  void merge(custom_forward_list&& other, Compare comp)
+  {
+    merge(other, comp);
+  }
+
+  void sort()
+  {
+    sort(std::less<T>{});
+  }
+
+  // Bottom-up merge sort. Runs of 2^i nodes are kept in bins, a node taken from the list is
+  // merged with the runs of bins 0, 1, ... until it finds an empty bin, like a binary counter.
+  template<typename Compare>
+  void sort(Compare comp)
+  {
+    c_fwd_list_node_base* bins[64]{};
+    std::size_t bins_used{0};
+    while(nullptr != head.next) {
+      c_fwd_list_node_base* carry = head.next;
+      head.next = carry->next;
+      carry->next = nullptr;
+      std::size_t i{0};
+      for(; nullptr != bins[i]; ++i) {
+        carry = merge_chains(bins[i], carry, comp);
+        bins[i] = nullptr;
+      }
+      bins[i] = carry;
+      bins_used = std::max(bins_used, i + 1);
+    }
+    // Higher bins hold earlier nodes, so they go first for the sort to stay stable.
+    for(std::size_t i = 0; i < bins_used; ++i)
+      if(nullptr != bins[i])
+        head.next = merge_chains(bins[i], head.next, comp);
+  }
+
+  void reverse() noexcept
+  {
+    c_fwd_list_node_base* reversed{nullptr};
+    while(nullptr != head.next) {
+      auto node = head.next;
+      head.next = node->next;
+      node->next = reversed;
+      reversed = node;
+    }
+    head.next = reversed;
+  }
+
+  // Erases all but the first of every run of equal consecutive elements, returns the number erased.
+  size_type unique()
+  {
+    return unique(std::equal_to<T>{});
+  }
+
+  template<typename BinaryPredicate>
+  size_type unique(BinaryPredicate pred)
+  {
+    const auto count_before = count;
+    auto node = head.next;
+    while(nullptr != node && nullptr != node->next) {
+      if(pred(value_of(node), value_of(node->next)))
+        erase_after(const_iterator{node});
+      else
+        node = node->next;
+    }
+    return count_before - count;
+  }
+
+  size_type remove(const T& value)
+  {
+    return remove_if([&value] (const T& element) { return element == value; });
+  }
+
+  template<typename UnaryPredicate>
+  size_type remove_if(UnaryPredicate pred)
+  {
+    const auto count_before = count;
+    c_fwd_list_node_base* prev = &head;
+    while(nullptr != prev->next) {
+      if(pred(value_of(prev->next)))
+        erase_after(const_iterator{prev});
+      else
+        prev = prev->next;
+    }
+    return count_before - count;
+  }
+
+  iterator before_begin() noexcept
+  {
+    return iterator{&head};
+  }
+
+  const_iterator before_begin() const noexcept
+  {
+    return const_iterator{&head};
+  }
+
+  const_iterator cbefore_begin() const noexcept
+  {
+    return const_iterator{&head};
+  }
+
   iterator begin() noexcept
   {
     return iterator{head.next};
@@ -282,21 +566,127 @@ public:
 
 private:
 
-  void copy(const_iterator first, const_iterator last)
+  template<typename ... Args>
+  Node* create_node(Args&& ... args)
   {
-    auto size = std::distance(first, last);
-    while(0 < size)
-    {
-      auto first_copy = first;
-      for(decltype(size) i = 0; i < size - 1; ++i)
-        ++first_copy;
-      push_front(*first_copy);
-      --size;
+    Node* node = allocator.allocate(1);
+    try {
+      allocator.construct(node, std::forward<Args>(args)...);
+    }
+    catch(...) {
+      allocator.deallocate(node, 1);
+      throw;
     }
+    return node;
+  }
+
+  void destroy_node(Node* node)
+  {
+    allocator.destroy(node);
+    allocator.deallocate(node, 1);
+  }
+
+  // Positions are const_iterators as in std::forward_list, the list itself is not const.
+  static c_fwd_list_node_base* mutable_node(const_iterator pos) noexcept
+  {
+    return const_cast<c_fwd_list_node_base*>(pos.node);
+  }
+
+  iterator link_after(const_iterator pos, Node* node) noexcept
+  {
+    auto prev = mutable_node(pos);
+    node->next = prev->next;
+    prev->next = node;
+    ++count;
+    return iterator{node};
+  }
+
+  // Moves the nodes following before_first up to and including last after pos.
+  static void relink_after(const_iterator pos, c_fwd_list_node_base* before_first, c_fwd_list_node_base* last) noexcept
+  {
+    auto prev = mutable_node(pos);
+    auto first = before_first->next;
+    before_first->next = last->next;
+    last->next = prev->next;
+    prev->next = first;
   }
 
+  static T& value_of(c_fwd_list_node_base* node) noexcept
+  {
+    return static_cast<Node*>(node)->value;
+  }
+
+  // Merges two sorted null-terminated chains, a node of second goes after equal nodes of first.
+  template<typename Compare>
+  static c_fwd_list_node_base* merge_chains(c_fwd_list_node_base* first, c_fwd_list_node_base* second, Compare& comp)
+  {
+    c_fwd_list_node_base merged;
+    auto tail = &merged;
+    while(nullptr != first && nullptr != second) {
+      if(comp(value_of(second), value_of(first))) {
+        tail->next = second;
+        second = second->next;
+      }
+      else {
+        tail->next = first;
+        first = first->next;
+      }
+      tail = tail->next;
+    }
+    tail->next = nullptr != first ? first : second;
+    return merged.next;
+  }
+
+  // Links copies of [first, last) after tail in one pass, returns the last linked node.
+  // When the length of the range is known and the allocator has allocate_bulk, nodes
+  // are allocated in batches of up to bulk_nodes_count.
+  template<typename InputIt>
+  c_fwd_list_node_base* link_range_after(c_fwd_list_node_base* tail, InputIt first, InputIt last)
+  {
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr(std::is_base_of<std::forward_iterator_tag, category>::value && has_allocate_bulk<Allocator_Node, Node*>::value) {
+      auto remaining = static_cast<size_type>(std::distance(first, last));
+      Node* nodes[bulk_nodes_count];
+      while(0 < remaining) {
+        const auto batch = std::min(remaining, bulk_nodes_count);
+        allocator.allocate_bulk(nodes, batch);
+        size_type i{0};
+        try {
+          for(; i < batch; ++i, ++first) {
+            allocator.construct(nodes[i], *first);
+            tail = link_after(const_iterator{tail}, nodes[i]).node;
+          }
+        }
+        catch(...) {
+          for(; i < batch; ++i)
+            allocator.deallocate(nodes[i], 1);
+          throw;
+        }
+        remaining -= batch;
+      }
+    }
+    else {
+      for(; first != last; ++first)
+        tail = link_after(const_iterator{tail}, create_node(*first)).node;
+    }
+    return tail;
+  }
+
+  // Appends copies of [first, last), keeping the last node as the tail.
+  void copy(const_iterator first, const_iterator last)
+  {
+    c_fwd_list_node_base* tail = &head;
+    while(nullptr != tail->next)
+      tail = tail->next;
+    link_range_after(tail, first, last);
+  }
+
+  static constexpr size_type bulk_nodes_count = 256;
+
   c_fwd_list_node_base  head;
   Allocator_Node        allocator;
+  // Kept by every operation which links or unlinks nodes, so size() does not walk the list.
+  size_type             count{};
 
 };
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <map>
 #include "homework_3.h"
 #include "utils.h"
@@ -1,22 +1,937 @@
 #include <cstdlib>
 #include <stdio.h>
 #include <new>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <execinfo.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "newdelete.h"
+#include "concurrent_allocator.h"
 
 namespace homework3 {
 
-  std::size_t alloc_counter = 0;
+  namespace {
 
-  void* malloc(std::size_t size)  throw (std::bad_alloc)
+    std::uintptr_t round_down(std::uintptr_t value, std::size_t alignment)
+    {
+      return value / alignment * alignment;
+    }
+
+    std::uintptr_t round_up(std::uintptr_t value, std::size_t alignment)
+    {
+      return round_down(value + alignment - 1, alignment);
+    }
+
+
+    // Every thread updates one shard, picked in turn when the thread allocates first, so
+    // threads do not contend for one cache line unless there are more of them than shards.
+    // Counters only grow, the live values are differences of the sums over all shards.
+    constexpr std::size_t shards_count = 64;
+
+    struct alignas(64) counters_shard {
+      std::atomic<std::size_t> allocations{0};
+      std::atomic<std::size_t> deallocations{0};
+      std::atomic<std::size_t> bytes_allocated{0};
+      std::atomic<std::size_t> bytes_freed{0};
+      std::atomic<std::size_t> sizes[size_histogram_buckets]{};
+    };
+
+    counters_shard shards[shards_count];
+    std::atomic<std::size_t> next_shard{0};
+
+    counters_shard& local_shard() noexcept
+    {
+      static thread_local counters_shard* shard = &shards[next_shard.fetch_add(1, std::memory_order_relaxed) % shards_count];
+      return *shard;
+    }
+
+    void count_allocation(std::size_t bytes) noexcept
+    {
+      auto& shard = local_shard();
+      shard.allocations.fetch_add(1, std::memory_order_relaxed);
+      shard.bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void count_deallocation(std::size_t bytes) noexcept
+    {
+      auto& shard = local_shard();
+      shard.deallocations.fetch_add(1, std::memory_order_relaxed);
+      shard.bytes_freed.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+
+    // Sampled call stacks are kept in an open addressing table keyed by the hash of the
+    // frames. Sampling is rare, so a spin lock suffices. A thread which allocates while it
+    // records or reports, backtrace does on its first call, is not profiled again.
+    constexpr std::size_t stack_depth = 16;
+    constexpr std::size_t sites_capacity = 1024;
+    constexpr std::size_t max_reported_sites = 32;
+
+    struct call_site {
+      std::size_t hash;
+      std::size_t samples;
+      std::size_t bytes;
+      int depth;
+      void* frames[stack_depth];
+    };
+
+    std::atomic<bool> profiling{false};
+    std::atomic<std::size_t> sample_period{1};
+    std::atomic<bool> report_registered{false};
+    std::atomic_flag sites_lock = ATOMIC_FLAG_INIT;
+    call_site sites[sites_capacity];
+    std::size_t sites_used{0};
+    std::size_t dropped_samples{0};
+    thread_local bool in_profiler{false};
+    thread_local std::size_t allocations_since_sample{0};
+
+    class spin_guard {
+    public:
+      explicit spin_guard(std::atomic_flag& _lock) noexcept
+        : lock(_lock)
+      {
+        while(lock.test_and_set(std::memory_order_acquire))
+          std::this_thread::yield();
+      }
+
+      ~spin_guard()
+      {
+        lock.clear(std::memory_order_release);
+      }
+
+    private:
+      std::atomic_flag& lock;
+    };
+
+    std::size_t size_bucket(std::size_t size) noexcept
+    {
+      return size ? 63 - __builtin_clzll(size) : 0;
+    }
+
+    std::size_t stack_hash(void* const* frames, int depth) noexcept
+    {
+      std::size_t hash = 14695981039346656037ull;
+      for(auto i = 0; i < depth; ++i)
+        hash = (hash ^ reinterpret_cast<std::uintptr_t>(frames[i])) * 1099511628211ull;
+      return hash;
+    }
+
+    void record_site(std::size_t size) noexcept
+    {
+      void* frames[stack_depth];
+      const auto depth = backtrace(frames, stack_depth);
+      const auto hash = stack_hash(frames, depth);
+
+      spin_guard guard{sites_lock};
+      for(std::size_t i = 0; i < sites_capacity; ++i) {
+        auto& site = sites[(hash + i) % sites_capacity];
+        if(0 == site.samples) {
+          site.hash = hash;
+          site.depth = depth;
+          std::copy(frames, frames + depth, site.frames);
+          ++sites_used;
+        }
+        else if(site.hash != hash || site.depth != depth || !std::equal(frames, frames + depth, site.frames))
+          continue;
+        ++site.samples;
+        site.bytes += size;
+        return;
+      }
+      ++dropped_samples;
+    }
+
+    void profile_allocation(std::size_t size) noexcept
+    {
+      if(!profiling.load(std::memory_order_relaxed) || in_profiler)
+        return;
+      local_shard().sizes[size_bucket(size)].fetch_add(1, std::memory_order_relaxed);
+      if(++allocations_since_sample < sample_period.load(std::memory_order_relaxed))
+        return;
+      allocations_since_sample = 0;
+      in_profiler = true;
+      record_site(size);
+      in_profiler = false;
+    }
+
+    void report_at_exit() noexcept
+    {
+      write_profile_report(stderr);
+    }
+
+
+    // Leak detection keeps every live allocation in a hash table, split into shards by the
+    // hash of the pointer, every shard under its own spin lock. A shard is a linear probing
+    // table, freed entries are removed by shifting back the entries of their probe run, and a
+    // ring of the last frees which tells a double free from a free of an unknown pointer.
+    // An address leaves the ring as soon as it is allocated again, whether the allocation is
+    // tracked or not. Tables are mapped by mmap and doubled when three quarters full, pages are
+    // backed by memory only when entries land on them. Nothing is allocated or printed under
+    // a shard lock, so allocations made meanwhile by backtrace or stdio may take the lock.
+    constexpr std::size_t detector_shards_count = 64;
+    constexpr std::size_t initial_live_capacity = 4096;
+    constexpr std::size_t freed_capacity = 64;
+
+    struct tracked_allocation {
+      const void* pointer;
+      std::size_t size;
+      int depth;
+      void* frames[stack_depth];
+    };
+
+    struct detector_shard {
+      std::atomic_flag lock;
+      std::size_t live_count;
+      std::size_t live_capacity;
+      std::size_t next_freed;
+      tracked_allocation* live;
+      tracked_allocation freed[freed_capacity];
+    };
+
+    std::atomic<bool> leak_detection{false};
+    std::atomic<bool> strict_detection{false};
+    std::atomic<bool> detector_overflowed{false};
+    std::atomic<bool> leak_report_registered{false};
+    std::atomic<detector_shard*> detector_shards{nullptr};
+    std::mutex detector_shards_mutex;
+    thread_local bool in_detector{false};
+
+    std::size_t pointer_hash(const void* p) noexcept
+    {
+      return (reinterpret_cast<std::uintptr_t>(p) >> 4) * 11400714819323198485ull;
+    }
+
+    detector_shard& shard_of(std::size_t hash) noexcept
+    {
+      return detector_shards.load(std::memory_order_relaxed)[hash >> 58];
+    }
+
+    tracked_allocation* map_live(std::size_t capacity) noexcept
+    {
+      void* p = mmap(nullptr, capacity * sizeof(tracked_allocation), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      return (MAP_FAILED == p) ? nullptr : static_cast<tracked_allocation*>(p);
+    }
+
+    void unmap_live(tracked_allocation* live, std::size_t capacity) noexcept
+    {
+      if(live)
+        munmap(live, capacity * sizeof(tracked_allocation));
+    }
+
+    std::size_t find_live(const tracked_allocation* live, std::size_t capacity, const void* p, std::size_t hash) noexcept
+    {
+      for(auto i = hash % capacity; ; i = (i + 1) % capacity) {
+        if(nullptr == live[i].pointer || p == live[i].pointer)
+          return i;
+      }
+    }
+
+    std::size_t find_live(const detector_shard& shard, const void* p, std::size_t hash) noexcept
+    {
+      return find_live(shard.live, shard.live_capacity, p, hash);
+    }
+
+    void erase_live(detector_shard& shard, std::size_t position) noexcept
+    {
+      const auto capacity = shard.live_capacity;
+      auto hole = position;
+      for(auto i = (hole + 1) % capacity; nullptr != shard.live[i].pointer; i = (i + 1) % capacity) {
+        const auto home = pointer_hash(shard.live[i].pointer) % capacity;
+        // An entry moves into the hole unless its home lies cyclically between the hole and it.
+        if((i > hole && (home <= hole || home > i)) || (i < hole && home <= hole && home > i)) {
+          shard.live[hole] = shard.live[i];
+          hole = i;
+        }
+      }
+      shard.live[hole].pointer = nullptr;
+      --shard.live_count;
+    }
+
+    // Moves the entries into a table twice as large, false when it cannot be mapped.
+    bool grow_live(detector_shard& shard) noexcept
+    {
+      const auto capacity = 2 * shard.live_capacity;
+      auto live = map_live(capacity);
+      if(!live)
+        return false;
+      for(std::size_t i = 0; i < shard.live_capacity; ++i) {
+        if(nullptr != shard.live[i].pointer)
+          live[find_live(live, capacity, shard.live[i].pointer, pointer_hash(shard.live[i].pointer))] = shard.live[i];
+      }
+      unmap_live(shard.live, shard.live_capacity);
+      shard.live = live;
+      shard.live_capacity = capacity;
+      return true;
+    }
+
+    void forget_freed(detector_shard& shard, const void* p) noexcept
+    {
+      for(auto& record : shard.freed) {
+        if(p == record.pointer)
+          record.pointer = nullptr;
+      }
+    }
+
+    void write_stack(const char* title, void* const* frames, int depth) noexcept
+    {
+      fprintf(stderr, "%s\n", title);
+      fflush(stderr);
+      backtrace_symbols_fd(frames, depth, fileno(stderr));
+    }
+
+    [[noreturn]] void report_bad_free(const char* error, const void* p, const tracked_allocation* freed) noexcept
+    {
+      in_detector = true;
+      void* frames[stack_depth];
+      const auto depth = backtrace(frames, stack_depth);
+      fprintf(stderr, "%s of %p\n", error, p);
+      write_stack("Freed at:", frames, depth);
+      if(freed)
+        write_stack("Previously freed at:", freed->frames, freed->depth);
+      std::abort();
+    }
+
+    void track_allocation(const void* p, std::size_t size) noexcept
+    {
+      if(!leak_detection.load(std::memory_order_relaxed))
+        return;
+      // Allocations of the detector itself are not tracked, but still take their address out of the ring.
+      const auto tracked = !in_detector;
+      void* frames[stack_depth];
+      int depth{0};
+      if(tracked) {
+        in_detector = true;
+        depth = backtrace(frames, stack_depth);
+      }
+      const auto hash = pointer_hash(p);
+      auto& shard = shard_of(hash);
+      auto overflowed = false;
+      {
+        spin_guard guard{shard.lock};
+        forget_freed(shard, p);
+        if(tracked) {
+          if(4 * (shard.live_count + 1) > 3 * shard.live_capacity && !grow_live(shard))
+            overflowed = !detector_overflowed.exchange(true, std::memory_order_relaxed);
+          else {
+            auto& entry = shard.live[find_live(shard, p, hash)];
+            if(nullptr == entry.pointer)
+              ++shard.live_count;
+            entry.pointer = p;
+            entry.size = size;
+            entry.depth = depth;
+            std::copy(frames, frames + depth, entry.frames);
+          }
+        }
+      }
+      if(overflowed)
+        fprintf(stderr, "Leak detection ran out of memory for its table, later allocations are not tracked\n");
+      if(tracked)
+        in_detector = false;
+    }
+
+    void track_deallocation(const void* p) noexcept
+    {
+      if(!leak_detection.load(std::memory_order_relaxed) || in_detector)
+        return;
+      in_detector = true;
+      void* frames[stack_depth];
+      const auto depth = backtrace(frames, stack_depth);
+      const auto hash = pointer_hash(p);
+      auto& shard = shard_of(hash);
+      const char* error{nullptr};
+      tracked_allocation freed{};
+      {
+        spin_guard guard{shard.lock};
+        const auto position = find_live(shard, p, hash);
+        if(nullptr != shard.live[position].pointer) {
+          auto& record = shard.freed[shard.next_freed++ % freed_capacity];
+          record.pointer = p;
+          record.size = shard.live[position].size;
+          record.depth = depth;
+          std::copy(frames, frames + depth, record.frames);
+          erase_live(shard, position);
+        }
+        else {
+          const auto last = std::find_if(std::begin(shard.freed), std::end(shard.freed),
+                                         [p] (const auto& record) { return p == record.pointer; });
+          if(std::end(shard.freed) != last) {
+            error = "Double free";
+            freed = *last;
+          }
+          else if(strict_detection.load(std::memory_order_relaxed) && !detector_overflowed.load(std::memory_order_relaxed))
+            error = "Free of unknown pointer";
+        }
+      }
+      if(error)
+        report_bad_free(error, p, freed.pointer ? &freed : nullptr);
+      in_detector = false;
+    }
+
+    void report_leaks_at_exit() noexcept
+    {
+      write_leak_report(stderr);
+    }
+
+
+    // Every size class of pooled new owns a range of the reserved address space. Batches of
+    // slots_per_batch slots are carved from the start of the range by the lockfree_depot of the
+    // class and cached per thread by detail::thread_cache, as slots of concurrent_allocator.
+    constexpr std::size_t pooled_classes = largest_pooled_new_size / pooled_new_granularity;
+    constexpr std::size_t class_range_size = std::size_t{1} << 30;
+    constexpr std::size_t slots_per_batch = 64;
+
+    std::atomic<bool> pooled_new{false};
+    std::atomic<char*> pooled_ranges{nullptr};
+    std::mutex pooled_ranges_mutex;
+
+    std::size_t class_for(std::size_t size) noexcept
+    {
+      return size ? (size - 1) / pooled_new_granularity : 0;
+    }
+
+    constexpr std::size_t class_size(std::size_t size_class) noexcept
+    {
+      return (size_class + 1) * pooled_new_granularity;
+    }
+
+    bool is_pooled(const void* p) noexcept
+    {
+      const auto ranges = pooled_ranges.load(std::memory_order_acquire);
+      return ranges && ranges <= p && p < ranges + pooled_classes * class_range_size;
+    }
+
+    std::size_t class_of(const void* p) noexcept
+    {
+      return (static_cast<const char*>(p) - pooled_ranges.load(std::memory_order_relaxed)) / class_range_size;
+    }
+
+    // Block source of the depot of a size class, returns nullptr once the range is used up.
+    template<std::size_t SIZE_CLASS>
+    class class_range_source {
+
+    public:
+
+      void* allocate(std::size_t size) noexcept
+      {
+        const auto offset = carved.fetch_add(size, std::memory_order_relaxed);
+        if(offset + size > class_range_size)
+          return nullptr;
+        return pooled_ranges.load(std::memory_order_relaxed) + SIZE_CLASS * class_range_size + offset;
+      }
+
+    private:
+
+      std::atomic<std::size_t> carved{0};
+    };
+
+    template<std::size_t SIZE_CLASS>
+    using class_cache = detail::thread_cache<basic_lockfree_depot<class_size(SIZE_CLASS), slots_per_batch, class_range_source<SIZE_CLASS>>,
+                                             slots_per_batch>;
+
+    template<std::size_t... SIZE_CLASSES>
+    constexpr std::array<void* (*)(), pooled_classes> class_allocators(std::index_sequence<SIZE_CLASSES...>) noexcept
+    {
+      return {{&class_cache<SIZE_CLASSES>::allocate...}};
+    }
+
+    template<std::size_t... SIZE_CLASSES>
+    constexpr std::array<void (*)(void*) noexcept, pooled_classes> class_deallocators(std::index_sequence<SIZE_CLASSES...>) noexcept
+    {
+      return {{&class_cache<SIZE_CLASSES>::deallocate...}};
+    }
+
+    constexpr auto allocators = class_allocators(std::make_index_sequence<pooled_classes>{});
+    constexpr auto deallocators = class_deallocators(std::make_index_sequence<pooled_classes>{});
+
+    void* allocate_pooled(std::size_t size_class) noexcept
+    {
+      return allocators[size_class]();
+    }
+
+    void deallocate_pooled(void* p, std::size_t size_class) noexcept
+    {
+      track_deallocation(p);
+      count_deallocation(class_size(size_class));
+      deallocators[size_class](p);
+    }
+
+  }
+
+  void use_pooled_new(bool enabled) noexcept
+  {
+    if(enabled && !pooled_ranges.load(std::memory_order_acquire)) {
+      // Pages of the ranges are not backed by memory until slots are carved on them.
+      std::lock_guard<std::mutex> lock{pooled_ranges_mutex};
+      if(!pooled_ranges.load(std::memory_order_relaxed)) {
+        void* p = mmap(nullptr, pooled_classes * class_range_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(MAP_FAILED == p)
+          return;
+        pooled_ranges.store(static_cast<char*>(p), std::memory_order_release);
+      }
+    }
+    pooled_new.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool pooled_new_enabled() noexcept
+  {
+    return pooled_new.load(std::memory_order_relaxed);
+  }
+
+  void* allocate_object(std::size_t size)
+  {
+    if(size <= largest_pooled_new_size && pooled_new.load(std::memory_order_relaxed)) {
+      const auto size_class = class_for(size);
+      if(auto p = allocate_pooled(size_class)) {
+        count_allocation(class_size(size_class));
+        profile_allocation(size);
+        track_allocation(p, size);
+        return p;
+      }
+    }
+    return malloc(size);
+  }
+
+  void deallocate_object(void* p) noexcept
+  {
+    if(is_pooled(p))
+      deallocate_pooled(p, class_of(p));
+    else
+      free(p);
+  }
+
+  void deallocate_object(void* p, std::size_t) noexcept
+  {
+    deallocate_object(p);
+  }
+
+  void* allocate_object(std::size_t size, std::size_t alignment)
+  {
+    if(alignment <= pooled_new_granularity)
+      return allocate_object(size);
+    const auto aligned_size = round_up(std::max<std::size_t>(size, 1), alignment);
+    if(aligned_size <= largest_pooled_new_size && pooled_new.load(std::memory_order_relaxed)) {
+      const auto size_class = class_for(aligned_size);
+      if(auto p = allocate_pooled(size_class)) {
+        count_allocation(class_size(size_class));
+        profile_allocation(size);
+        track_allocation(p, size);
+        return p;
+      }
+    }
+    return aligned_malloc(alignment, size);
+  }
+
+  void deallocate_object(void* p, std::size_t, std::size_t) noexcept
+  {
+    deallocate_object(p);
+  }
+
+  void start_profiling(std::size_t sample_period, bool report_at_exit) noexcept
+  {
+    // The first backtrace loads the unwinder, which is better done before profiling is on.
+    void* frame;
+    backtrace(&frame, 1);
+    homework3::sample_period.store(std::max<std::size_t>(sample_period, 1), std::memory_order_relaxed);
+    if(report_at_exit && !report_registered.exchange(true))
+      std::atexit(homework3::report_at_exit);
+    profiling.store(true, std::memory_order_relaxed);
+  }
+
+  void stop_profiling() noexcept
+  {
+    profiling.store(false, std::memory_order_relaxed);
+  }
+
+  void reset_profile() noexcept
+  {
+    for(auto& shard : shards)
+      for(auto& size : shard.sizes)
+        size.store(0, std::memory_order_relaxed);
+    spin_guard guard{sites_lock};
+    std::fill(std::begin(sites), std::end(sites), call_site{});
+    sites_used = 0;
+    dropped_samples = 0;
+  }
+
+  size_histogram allocation_size_histogram() noexcept
+  {
+    size_histogram histogram{};
+    for(const auto& shard : shards)
+      for(std::size_t i = 0; i < size_histogram_buckets; ++i)
+        histogram[i] += shard.sizes[i].load(std::memory_order_relaxed);
+    return histogram;
+  }
+
+  std::size_t profiled_sites_count() noexcept
+  {
+    spin_guard guard{sites_lock};
+    return sites_used;
+  }
+
+  void write_profile_report(FILE* out, std::size_t top_sites) noexcept
+  {
+    // Hottest sites are copied out, so printing, which may allocate, is done without the lock.
+    const auto was_in_profiler = in_profiler;
+    in_profiler = true;
+    call_site hottest[max_reported_sites];
+    std::size_t hottest_count{0};
+    std::size_t sites_count{0};
+    std::size_t dropped{0};
+    {
+      std::uint16_t indices[sites_capacity];
+      spin_guard guard{sites_lock};
+      for(std::size_t i = 0; i < sites_capacity; ++i)
+        if(sites[i].samples)
+          indices[sites_count++] = i;
+      hottest_count = std::min({top_sites, max_reported_sites, sites_count});
+      std::partial_sort(indices, indices + hottest_count, indices + sites_count,
+                        [] (auto lhs, auto rhs) { return sites[lhs].samples > sites[rhs].samples; });
+      for(std::size_t i = 0; i < hottest_count; ++i)
+        hottest[i] = sites[indices[i]];
+      dropped = dropped_samples;
+    }
+
+    const auto histogram = allocation_size_histogram();
+    fprintf(out, "Allocation sizes:\n");
+    for(std::size_t i = 0; i < size_histogram_buckets; ++i)
+      if(histogram[i])
+        fprintf(out, "  %20zu - %20zu: %zu\n", i ? std::size_t{1} << i : 0, (std::size_t{1} << i << 1) - 1, histogram[i]);
+    fprintf(out, "Sampled call sites: %zu, dropped samples: %zu\n", sites_count, dropped);
+    for(std::size_t i = 0; i < hottest_count; ++i) {
+      fprintf(out, "#%zu: %zu samples, %zu bytes\n", i + 1, hottest[i].samples, hottest[i].bytes);
+      fflush(out);
+      backtrace_symbols_fd(hottest[i].frames, hottest[i].depth, fileno(out));
+    }
+    fflush(out);
+    in_profiler = was_in_profiler;
+  }
+
+  void start_leak_detection(bool strict, bool report_at_exit) noexcept
+  {
+    if(!detector_shards.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock{detector_shards_mutex};
+      if(!detector_shards.load(std::memory_order_relaxed)) {
+        void* p = mmap(nullptr, detector_shards_count * sizeof(detector_shard), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(MAP_FAILED == p)
+          return;
+        detector_shards.store(static_cast<detector_shard*>(p), std::memory_order_release);
+      }
+    }
+    // The first backtrace loads the unwinder, which is better done before detection is on.
+    void* frame;
+    backtrace(&frame, 1);
+    // Tables grown by the previous detection are replaced with fresh ones, which come zeroed.
+    auto shards = detector_shards.load(std::memory_order_relaxed);
+    for(std::size_t i = 0; i < detector_shards_count; ++i) {
+      auto live = map_live(initial_live_capacity);
+      spin_guard guard{shards[i].lock};
+      unmap_live(shards[i].live, shards[i].live_capacity);
+      shards[i].live = live;
+      shards[i].live_capacity = live ? initial_live_capacity : 0;
+      shards[i].live_count = 0;
+      for(auto& record : shards[i].freed)
+        record.pointer = nullptr;
+      if(!live)
+        return;
+    }
+    detector_overflowed.store(false, std::memory_order_relaxed);
+    strict_detection.store(strict, std::memory_order_relaxed);
+    if(report_at_exit && !leak_report_registered.exchange(true))
+      std::atexit(report_leaks_at_exit);
+    leak_detection.store(true, std::memory_order_release);
+  }
+
+  void stop_leak_detection() noexcept
+  {
+    leak_detection.store(false, std::memory_order_relaxed);
+  }
+
+  bool leak_detection_overflowed() noexcept
+  {
+    return detector_overflowed.load(std::memory_order_relaxed);
+  }
+
+  std::size_t tracked_allocations_count() noexcept
+  {
+    auto shards = detector_shards.load(std::memory_order_acquire);
+    if(!shards)
+      return 0;
+    std::size_t count{0};
+    for(std::size_t i = 0; i < detector_shards_count; ++i) {
+      spin_guard guard{shards[i].lock};
+      count += shards[i].live_count;
+    }
+    return count;
+  }
+
+  std::size_t write_leak_report(FILE* out) noexcept
+  {
+    auto shards = detector_shards.load(std::memory_order_acquire);
+    if(!shards)
+      return 0;
+    // An entry is copied out before it is printed, so printing, which may allocate, is done without the lock.
+    const auto was_in_detector = in_detector;
+    in_detector = true;
+    std::size_t leaks{0};
+    std::size_t bytes{0};
+    for(std::size_t i = 0; i < detector_shards_count; ++i) {
+      for(std::size_t position = 0; ; ++position) {
+        tracked_allocation entry;
+        {
+          spin_guard guard{shards[i].lock};
+          if(shards[i].live_capacity <= position)
+            break;
+          entry = shards[i].live[position];
+        }
+        if(nullptr == entry.pointer)
+          continue;
+        ++leaks;
+        bytes += entry.size;
+        fprintf(out, "Leak of %zu bytes at %p, allocated at:\n", entry.size, entry.pointer);
+        fflush(out);
+        backtrace_symbols_fd(entry.frames, entry.depth, fileno(out));
+      }
+    }
+    fprintf(out, "Leaks: %zu, %zu bytes%s\n", leaks, bytes,
+            detector_overflowed.load(std::memory_order_relaxed) ? ", some allocations were not tracked" : "");
+    fflush(out);
+    in_detector = was_in_detector;
+    return leaks;
+  }
+
+  allocation_stats allocation_totals() noexcept
+  {
+    allocation_stats totals;
+    for(const auto& shard : shards) {
+      totals.allocations += shard.allocations.load(std::memory_order_relaxed);
+      totals.deallocations += shard.deallocations.load(std::memory_order_relaxed);
+      totals.bytes_allocated += shard.bytes_allocated.load(std::memory_order_relaxed);
+      totals.bytes_freed += shard.bytes_freed.load(std::memory_order_relaxed);
+    }
+    return totals;
+  }
+
+  std::size_t alloc_counter() noexcept
+  {
+    return allocation_totals().live_allocations();
+  }
+
+  std::size_t malloc_calls() noexcept
+  {
+    return allocation_totals().allocations;
+  }
+
+  std::size_t allocated_bytes() noexcept
+  {
+    return allocation_totals().live_bytes();
+  }
+
+  void* malloc(std::size_t size)
   {
     void* p = std::malloc(size);
-    ++alloc_counter;
+    if(p) {
+      count_allocation(malloc_usable_size(p));
+      profile_allocation(size);
+      track_allocation(p, size);
+    }
+    return p;
+  }
+
+  void* aligned_malloc(std::size_t alignment, std::size_t size) noexcept
+  {
+    void* p{nullptr};
+    if(0 != posix_memalign(&p, alignment, size))
+      return nullptr;
+    count_allocation(malloc_usable_size(p));
+    profile_allocation(size);
+    track_allocation(p, size);
     return p;
   }
 
   void free(void* p) noexcept
   {
-    --alloc_counter;
+    if(!p)
+      return;
+    track_deallocation(p);
+    count_deallocation(malloc_usable_size(p));
     std::free(p);
     return;
   }
+
+  std::size_t page_size() noexcept
+  {
+    static const std::size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+  void* map_pages(std::size_t alignment, std::size_t size, bool huge_pages) noexcept
+  {
+    alignment = std::max(alignment, page_size());
+    size = round_up(size, page_size());
+    const auto length = size + alignment - page_size();
+    void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == p)
+      return nullptr;
+
+    // The mapping is larger than asked, so the misaligned head and the rest of the tail are unmapped.
+    const auto begin = reinterpret_cast<std::uintptr_t>(p);
+    const auto aligned = round_up(begin, alignment);
+    if(aligned != begin)
+      munmap(p, aligned - begin);
+    if(begin + length != aligned + size)
+      munmap(reinterpret_cast<void*>(aligned + size), begin + length - aligned - size);
+
+    if(huge_pages)
+      madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+    count_allocation(size);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  void unmap_pages(void* p, std::size_t size) noexcept
+  {
+    size = round_up(size, page_size());
+    count_deallocation(size);
+    munmap(p, size);
+  }
+
+  void discard_pages(void* p, std::size_t size) noexcept
+  {
+    const auto begin = round_up(reinterpret_cast<std::uintptr_t>(p), page_size());
+    const auto end = round_down(reinterpret_cast<std::uintptr_t>(p) + size, page_size());
+    if(begin < end)
+      madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+  }
+}
+
+namespace {
+
+  void* allocate_or_throw(std::size_t size)
+  {
+    auto p = homework3::allocate_object(size);
+    if(!p)
+      throw std::bad_alloc();
+    return p;
+  }
+
+  void* allocate_or_throw(std::size_t size, std::align_val_t alignment)
+  {
+    auto p = homework3::allocate_object(size, static_cast<std::size_t>(alignment));
+    if(!p)
+      throw std::bad_alloc();
+    return p;
+  }
+
+}
+
+// Replacements of the global operators, defined out of line so that they replace the ones of
+// the C++ runtime in the whole program and objects are allocated and freed by the same functions
+// whether new and delete are called by this code or by the standard library.
+
+void* operator new(std::size_t size)
+{
+  return allocate_or_throw(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void* operator new[](std::size_t size)
+{
+  return allocate_or_throw(size);
+}
+
+void operator delete[](void* p) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return homework3::allocate_object(size);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return homework3::allocate_object(size);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void operator delete(void* p, std::size_t size) noexcept
+{
+  homework3::deallocate_object(p, size);
+}
+
+void operator delete[](void* p, std::size_t size) noexcept
+{
+  homework3::deallocate_object(p, size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocate_or_throw(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocate_or_throw(size, alignment);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return homework3::allocate_object(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return homework3::allocate_object(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  homework3::deallocate_object(p);
+}
+
+void operator delete(void* p, std::size_t size, std::align_val_t alignment) noexcept
+{
+  homework3::deallocate_object(p, size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* p, std::size_t size, std::align_val_t alignment) noexcept
+{
+  homework3::deallocate_object(p, size, static_cast<std::size_t>(alignment));
 }
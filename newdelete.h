@@ -1,67 +1,103 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>
+#include <array>
 #include <cstddef>
 #include <new>
 
 namespace homework3 {
 
-    extern std::size_t alloc_counter;
-    void* malloc(std::size_t size) throw (std::bad_alloc);
+    // Totals over all threads of allocations made by the functions below. Bytes are usable
+    // sizes of allocated memory, so a free is accounted exactly without being told the size.
+    struct allocation_stats {
+      std::size_t allocations{};
+      std::size_t deallocations{};
+      std::size_t bytes_allocated{};
+      std::size_t bytes_freed{};
+
+      std::size_t live_allocations() const noexcept
+      {
+        return allocations - deallocations;
+      }
+
+      std::size_t live_bytes() const noexcept
+      {
+        return bytes_allocated - bytes_freed;
+      }
+    };
+
+    allocation_stats allocation_totals() noexcept;
+    // Allocations not yet freed, all allocations ever made and bytes not yet freed.
+    std::size_t alloc_counter() noexcept;
+    std::size_t malloc_calls() noexcept;
+    std::size_t allocated_bytes() noexcept;
+
+    // Optional profiling of malloc and aligned_malloc. While it is on, requested sizes are
+    // counted in a log2 histogram, bucket i holding sizes from 2^i to 2^(i+1) - 1 and bucket 0
+    // also empty requests, and every sample_period-th allocation of a thread records its call
+    // stack. Profiling does not allocate, call sites which do not fit into a fixed table are
+    // counted as dropped.
+    constexpr std::size_t size_histogram_buckets = 64;
+    using size_histogram = std::array<std::size_t, size_histogram_buckets>;
+
+    void start_profiling(std::size_t sample_period, bool report_at_exit = false) noexcept;
+    void stop_profiling() noexcept;
+    // Clears the histogram and recorded call sites.
+    void reset_profile() noexcept;
+    size_histogram allocation_size_histogram() noexcept;
+    std::size_t profiled_sites_count() noexcept;
+    // Prints the histogram and the call sites sampled most often, hottest first.
+    void write_profile_report(FILE* out, std::size_t top_sites = 10) noexcept;
+
+    // Optional leak detection for malloc, aligned_malloc and free and the objects they serve.
+    // While it is on, every allocation is kept with its size and call stack until it is freed.
+    // A double free aborts with the stacks of both frees, so does, in strict mode, a free of
+    // a pointer not allocated while detection was on, which is meant for detection started
+    // before anything is allocated. The table grows with the number of live allocations. If
+    // memory for it runs out, a message is printed to stderr, later allocations are not
+    // tracked, and strict mode stops aborting on unknown pointers.
+    void start_leak_detection(bool strict = false, bool report_at_exit = false) noexcept;
+    void stop_leak_detection() noexcept;
+    // Whether some allocations were not tracked since detection was last started.
+    bool leak_detection_overflowed() noexcept;
+    std::size_t tracked_allocations_count() noexcept;
+    // Prints every tracked allocation not yet freed with its call stack, returns their count.
+    std::size_t write_leak_report(FILE* out) noexcept;
+
+    void* malloc(std::size_t size);
+    void* aligned_malloc(std::size_t alignment, std::size_t size) noexcept;
     void free(void* p) noexcept;
 
-}
-
-extern "C++" {
-
-inline void* operator new(std::size_t size) throw (std::bad_alloc)
-{
-    return homework3::malloc(size);
-}
-
-inline void operator delete(void* p) noexcept
-{
-    homework3::free(p);
-}
-
-inline void* operator new[](std::size_t size) throw (std::bad_alloc)
-{
-    return homework3::malloc(size);
-}
-
-inline void operator delete[](void* p) throw()
-{
-    homework3::free(p);
-}
-
-inline void* operator new(std::size_t size, const std::nothrow_t&) noexcept
-{
-  return homework3::malloc(size);
-}
-
-inline void operator delete(void* p, const std::nothrow_t&) noexcept
-{
-    homework3::free(p);
-}
-
-inline void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
-{
-  return homework3::malloc(size);
-}
-
-inline void operator delete[](void* p, const std::nothrow_t&) noexcept
-{
-    homework3::free(p);
-}
-
-inline void operator delete(void* p, long unsigned int)
-{
-    homework3::free(p);
-}
+    // Storage of objects created by the global operator new. By default it is allocated by
+    // malloc. With pooled new on, requests of up to largest_pooled_new_size bytes are rounded up
+    // to a multiple of pooled_new_granularity and served from free slots of that size class,
+    // cached per thread. Slots are carved out of a range of address space reserved for every
+    // size class, so the class of a slot is known from its address and an object may be deleted
+    // whether or not pooled new is still on. Slots are never given back to the kernel.
+    // The global operator new and delete replaced in newdelete.cpp call these functions, so
+    // they serve objects allocated or freed by the standard library too.
+    constexpr std::size_t pooled_new_granularity = 16;
+    constexpr std::size_t largest_pooled_new_size = 256;
+
+    void use_pooled_new(bool enabled) noexcept;
+    bool pooled_new_enabled() noexcept;
+    void* allocate_object(std::size_t size);
+    void deallocate_object(void* p) noexcept;
+    // The size class is always taken from the address, a wrong size cannot misroute the slot.
+    void deallocate_object(void* p, std::size_t size) noexcept;
+    // Over-aligned objects are pooled when their size rounded up to the alignment fits into
+    // a class, slots of a class whose size is a multiple of the alignment are aligned to it.
+    void* allocate_object(std::size_t size, std::size_t alignment);
+    void deallocate_object(void* p, std::size_t size, std::size_t alignment) noexcept;
+
+    std::size_t page_size() noexcept;
+    // Anonymous private mapping of at least size bytes, rounded up to whole pages and aligned
+    // to alignment. With huge_pages the kernel is advised to back it by transparent huge pages.
+    void* map_pages(std::size_t alignment, std::size_t size, bool huge_pages) noexcept;
+    void unmap_pages(void* p, std::size_t size) noexcept;
+    // Pages lying wholly within [p, p + size) are returned to the kernel but stay mapped.
+    void discard_pages(void* p, std::size_t size) noexcept;
 
-inline void operator delete [](void* p, long unsigned int)
-{
-    homework3::free(p);
 }
 
-} // extern "C++"
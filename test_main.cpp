@@ -1,18 +1,43 @@
 #include "version.h"
 #include "utils.h"
 #include "custom_allocator.h"
+#include "concurrent_allocator.h"
+#include "arena_allocator.h"
 #include "custom_forward_list.h"
 #include "homework_3.h"
 #include "newdelete.h"
 #include <map>
+#include <string>
+#include <array>
+#include <memory_resource>
+#include <vector>
+#include <deque>
+#include <list>
+#include <bitset>
+#include <forward_list>
+#include <set>
+#include <unordered_set>
+#include <unordered_map>
 #include <chrono>
 #include <numeric>
 #include <iterator>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <tuple>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define BOOST_TEST_MODULE test_main
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/included/unit_test.hpp>
+#include <boost/iterator/counting_iterator.hpp>
 
 using namespace homework3;
 
@@ -77,7 +102,7 @@ BOOST_AUTO_TEST_CASE(test_custom_allocator_less_allocations)
   };
 
   const auto allocate_block_size{10};
-  const auto alloc_counter_begin = alloc_counter;
+  const auto alloc_counter_begin = alloc_counter();
   {
     std::map<int, int, std::less<int>, custom_allocator<std::pair<const int, int>, allocate_block_size>> map_custom_allocator;
     
@@ -85,21 +110,859 @@ BOOST_AUTO_TEST_CASE(test_custom_allocator_less_allocations)
                     allocate_block_size,
                     pair_generator);
 
-    const auto alloc_counter_with_custom_allocations = alloc_counter;
+    const auto alloc_counter_with_custom_allocations = alloc_counter();
 
     std::map<int, int> map_default_allocator;
     std::generate_n(std::inserter(map_default_allocator, std::begin(map_default_allocator)),
                     allocate_block_size,
                     pair_generator);
-    BOOST_CHECK((alloc_counter_with_custom_allocations - alloc_counter_begin) < (alloc_counter - alloc_counter_with_custom_allocations));
+    BOOST_CHECK((alloc_counter_with_custom_allocations - alloc_counter_begin) < (alloc_counter() - alloc_counter_with_custom_allocations));
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_free_list_reuse)
+{
+  const auto allocate_block_size{10};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_allocator<uint64_t, allocate_block_size, allocation_mode::free_list> allocator;
+    auto p1 = allocator.allocate(1);
+    auto p2 = allocator.allocate(1);
+    BOOST_CHECK(p1 != p2);
+    allocator.deallocate(p1, 1);
+    BOOST_CHECK(p1 == allocator.allocate(1));
+
+    uint64_t* pointers[allocate_block_size + 1] = {p1, p2};
+    const auto alloc_counter_one_block = alloc_counter();
+    for(auto i = 2; i < allocate_block_size; ++i)
+      pointers[i] = allocator.allocate(1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_one_block);
+    pointers[allocate_block_size] = allocator.allocate(1);
+    BOOST_CHECK(alloc_counter() != alloc_counter_one_block);
+
+    for(auto p : pointers)
+      allocator.deallocate(p, 1);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+template<typename Allocator>
+void check_blocks_released_in_any_order()
+{
+  const auto allocate_block_size{10};
+  Allocator allocator;
+  allocator.deallocate(allocator.allocate(1), 1);
+  std::vector<typename Allocator::pointer> pointers;
+  pointers.reserve(3 * allocate_block_size);
+  const auto alloc_counter_begin = alloc_counter();
+
+  for(auto i = 0; i < 3 * allocate_block_size; ++i)
+    pointers.push_back(allocator.allocate(1));
+  BOOST_CHECK(alloc_counter() != alloc_counter_begin);
+
+  for(auto i = 0; i < 3 * allocate_block_size; i += 2)
+    allocator.deallocate(pointers[i], 1);
+  for(auto i = 3 * allocate_block_size - 1; i > 0; i -= 2)
+    allocator.deallocate(pointers[i], 1);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_empty_blocks_released)
+{
+  check_blocks_released_in_any_order<custom_allocator<uint64_t, 10, allocation_mode::free_list>>();
+  check_blocks_released_in_any_order<custom_allocator<uint64_t, 10, allocation_mode::bitset>>();
+}
+
+template<typename Allocator>
+void check_contiguous_allocation()
+{
+  const auto allocate_block_size{10};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    Allocator allocator;
+    allocator.deallocate(allocator.allocate(1), 1);
+    const auto alloc_counter_empty_pool = alloc_counter();
+
+    auto single = allocator.allocate(1);
+    auto run = allocator.allocate(4);
+    for(auto i = 0; i < 4; ++i)
+      BOOST_CHECK((single < run) || (single >= run + 4));
+    std::fill(run, run + 4, 0xDEADBEEF);
+    BOOST_CHECK(4 == std::count(run, run + 4, 0xDEADBEEF));
+
+    const auto alloc_counter_before_large = alloc_counter();
+    auto large = allocator.allocate(allocate_block_size + 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_before_large + 1);
+    allocator.deallocate(large, allocate_block_size + 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_before_large);
+
+    allocator.deallocate(run, 4);
+    allocator.deallocate(single, 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_empty_pool);
+
+    auto full_block = allocator.allocate(allocate_block_size);
+    allocator.deallocate(full_block, allocate_block_size);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_contiguous_allocation)
+{
+  check_contiguous_allocation<custom_allocator<uint64_t, 10, allocation_mode::free_list>>();
+  check_contiguous_allocation<custom_allocator<uint64_t, 10, allocation_mode::bitset>>();
+}
+
+template<template<typename> class Allocator>
+void check_standard_containers()
+{
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    std::vector<int, Allocator<int>> vector;
+    std::deque<int, Allocator<int>> deque;
+    std::list<int, Allocator<int>> list;
+    std::forward_list<int, Allocator<int>> forward_list;
+    std::set<int, std::less<int>, Allocator<int>> set;
+    std::map<int, int, std::less<int>, Allocator<std::pair<const int, int>>> map;
+    std::unordered_set<int, std::hash<int>, std::equal_to<int>, Allocator<int>> unordered_set;
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Allocator<std::pair<const int, int>>> unordered_map;
+
+    for(auto i = 0; i < 1000; ++i) {
+      vector.push_back(i);
+      deque.push_front(i);
+      deque.push_back(i);
+      list.push_back(i);
+      forward_list.push_front(i);
+      set.insert(i);
+      map.emplace(i, i);
+      unordered_set.insert(i);
+      unordered_map.emplace(i, i);
+    }
+    for(auto i = 0; i < 1000; i += 2) {
+      deque.pop_front();
+      list.pop_front();
+      forward_list.pop_front();
+      set.erase(i);
+      map.erase(i);
+      unordered_set.erase(i);
+      unordered_map.erase(i);
+    }
+    vector.resize(10);
+    vector.shrink_to_fit();
+
+    BOOST_CHECK(std::equal(std::cbegin(vector), std::cend(vector), boost::counting_iterator<int>(0)));
+    BOOST_CHECK(1500 == deque.size());
+    BOOST_CHECK(500 == list.size());
+    BOOST_CHECK(500 == std::distance(std::cbegin(forward_list), std::cend(forward_list)));
+    BOOST_CHECK(500 == set.size());
+    BOOST_CHECK(500 == map.size());
+    BOOST_CHECK(500 == unordered_set.size());
+    BOOST_CHECK(500 == unordered_map.size());
+    for(auto i = 1; i < 1000; i += 2) {
+      BOOST_CHECK(1 == set.count(i));
+      BOOST_CHECK(i == map.at(i));
+      BOOST_CHECK(1 == unordered_set.count(i));
+      BOOST_CHECK(i == unordered_map.at(i));
+    }
+
+    auto vector_copy = vector;
+    BOOST_CHECK(vector_copy == vector);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+template<typename T>
+using free_list_allocator = custom_allocator<T, 10, allocation_mode::free_list>;
+
+template<typename T>
+using bitset_allocator = custom_allocator<T, 10, allocation_mode::bitset>;
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_standard_containers)
+{
+  check_standard_containers<free_list_allocator>();
+  check_standard_containers<bitset_allocator>();
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_shared_pool)
+{
+  using allocator_type = custom_allocator<uint64_t, 10>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    allocator_type allocator_1;
+    allocator_type allocator_2;
+    BOOST_CHECK(allocator_1 != allocator_2);
+
+    auto allocator_copy = allocator_1;
+    BOOST_CHECK(allocator_copy == allocator_1);
+    auto p = allocator_1.allocate(1);
+    allocator_copy.deallocate(p, 1);
+
+    allocator_type::rebind<int>::other allocator_rebind{allocator_1};
+    BOOST_CHECK(allocator_rebind == allocator_1);
+    BOOST_CHECK(allocator_rebind.get_pool() == allocator_1.get_pool());
+
+    auto allocator_moved = std::move(allocator_copy);
+    BOOST_CHECK(allocator_moved == allocator_1);
+    BOOST_CHECK(allocator_copy == allocator_1);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_shared_pool_containers)
+{
+  using allocator_type = custom_allocator<std::pair<const int, int>, 10>;
+  using map_type = std::map<int, int, std::less<int>, allocator_type>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    allocator_type allocator;
+    map_type map_1{allocator};
+    map_type map_2{allocator};
+    map_1.emplace(0, 0);
+    const auto alloc_counter_one_block = alloc_counter();
+    for(auto i = 1; i < 5; ++i)
+      map_1.emplace(i, i);
+    for(auto i = 0; i < 5; ++i)
+      map_2.emplace(i, i);
+    BOOST_CHECK(alloc_counter() == alloc_counter_one_block);
+
+    auto address = &*map_1.begin();
+    map_type map_3{std::move(map_1)};
+    BOOST_CHECK(address == &*map_3.begin());
+    BOOST_CHECK(map_3.get_allocator() == allocator);
+
+    map_type map_4;
+    BOOST_CHECK(map_4.get_allocator() != allocator);
+    map_4 = std::move(map_3);
+    BOOST_CHECK(address == &*map_4.begin());
+    BOOST_CHECK(map_4.get_allocator() == allocator);
+
+    map_type map_5;
+    map_5.swap(map_4);
+    BOOST_CHECK(address == &*map_5.begin());
+    BOOST_CHECK(map_5.get_allocator() == allocator);
+
+    auto map_6 = map_5;
+    BOOST_CHECK(map_6 == map_5);
+    BOOST_CHECK(map_6.get_allocator() == allocator);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_bitset_mode)
+{
+  auto pair_generator = [i=0] () mutable {
+    auto value = std::make_pair(i, i);
+    ++i;
+    return value;
+  };
+
+  const auto allocate_block_size{10};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    std::map<int, int, std::less<int>, custom_allocator<std::pair<const int, int>, allocate_block_size, allocation_mode::bitset>> map_bitset;
+    std::map<int, int, std::less<int>, custom_allocator<std::pair<const int, int>, allocate_block_size, allocation_mode::free_list>> map_free_list;
+    std::generate_n(std::inserter(map_bitset, std::begin(map_bitset)),
+                    3 * allocate_block_size,
+                    pair_generator);
+    std::copy(std::cbegin(map_bitset), std::cend(map_bitset), std::inserter(map_free_list, std::begin(map_free_list)));
+
+    for(auto i = 0; i < 3 * allocate_block_size; i += 2) {
+      map_bitset.erase(i);
+      map_free_list.erase(i);
+    }
+    BOOST_CHECK(std::equal(std::cbegin(map_bitset), std::cend(map_bitset),
+                           std::cbegin(map_free_list), std::cend(map_free_list)));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_size_classes)
+{
+  // Nodes of both containers are of different sizes within one size class.
+  using value_type = std::array<double, 5>;
+  const auto allocate_block_size{10};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    auto pool = std::make_shared<block_pool>(allocate_block_size);
+    custom_allocator<std::pair<const int, int>, allocate_block_size> map_allocator{pool};
+    custom_allocator<value_type, allocate_block_size> list_allocator{pool};
+    std::map<int, int, std::less<int>, decltype(map_allocator)> map{map_allocator};
+    custom_forward_list<value_type, decltype(list_allocator)> list{list_allocator};
+
+    map.emplace(0, 0);
+    const auto alloc_counter_one_block = alloc_counter();
+    for(auto i = 1; i < allocate_block_size / 2; ++i)
+      map.emplace(i, i);
+    for(auto i = 0; i < allocate_block_size / 2; ++i)
+      list.push_front(value_type{});
+    BOOST_CHECK(alloc_counter() == alloc_counter_one_block);
+
+    auto run = list_allocator.allocate(2);
+    BOOST_CHECK(alloc_counter() == alloc_counter_one_block + 1);
+    list_allocator.deallocate(run, 2);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+template<typename Allocator>
+std::size_t count_chunks(Allocator allocator, std::size_t elements_count)
+{
+  allocator.deallocate(allocator.allocate(1), 1);
+  const auto alloc_counter_empty_pool = alloc_counter();
+
+  std::vector<typename Allocator::pointer> pointers;
+  pointers.reserve(elements_count);
+  const auto alloc_counter_begin = alloc_counter();
+  for(std::size_t i = 0; i < elements_count; ++i)
+    pointers.push_back(allocator.allocate(1));
+  const auto chunks_count = alloc_counter() - alloc_counter_begin;
+  for(auto p : pointers)
+    allocator.deallocate(p, 1);
+  pointers.clear();
+  pointers.shrink_to_fit();
+  BOOST_CHECK(alloc_counter() == alloc_counter_empty_pool);
+  return chunks_count;
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_zero_size)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  for(auto mode : {allocation_mode::free_list, allocation_mode::bitset}) {
+    block_pool pool{2, mode};
+    std::vector<void*> pointers;
+    for(auto i = 0; i < 5; ++i)
+      pointers.push_back(pool.allocate_slots(sizeof(int), alignof(int), 0));
+    BOOST_CHECK(std::set<void*>(std::cbegin(pointers), std::cend(pointers)).size() == pointers.size());
+    BOOST_CHECK(pointers.size() == pool.stats().live_slots);
+    for(auto p : pointers)
+      pool.deallocate_slots(p, sizeof(int), alignof(int), 0);
+    BOOST_CHECK(0 == pool.stats().live_slots);
+    BOOST_CHECK(0 == pool.stats().blocks);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_bulk_allocation)
+{
+  const std::size_t slots_count{50};
+  const auto alloc_counter_begin = alloc_counter();
+  for(auto mode : {allocation_mode::free_list, allocation_mode::bitset}) {
+    block_pool pool{10, mode};
+    std::array<void*, slots_count> slots;
+    pool.allocate_slots_bulk(sizeof(int), alignof(int), slots.data(), slots_count);
+    BOOST_CHECK(slots_count == pool.stats().live_slots);
+    for(auto p : slots)
+      pool.deallocate_slots(p, sizeof(int), alignof(int), 1);
+    BOOST_CHECK(pool.stats().allocations == pool.stats().deallocations);
+
+    // The third chunk cannot be obtained, the slots taken from the first two are given back.
+    block_pool failing_pool{10, mode, block_pool::default_largest_pooled_size,
+                            [] (std::size_t chunks_count) -> std::size_t {
+                              if(2 == chunks_count)
+                                throw std::bad_alloc();
+                              return 1;
+                            }};
+    BOOST_CHECK_THROW(failing_pool.allocate_slots_bulk(sizeof(int), alignof(int), slots.data(), slots_count), std::bad_alloc);
+    BOOST_CHECK(0 == failing_pool.stats().live_slots);
+    BOOST_CHECK(failing_pool.stats().allocations == failing_pool.stats().deallocations);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_growth_policy)
+{
+  const auto allocate_block_size{10};
+  using allocator_type = custom_allocator<uint64_t, allocate_block_size>;
+  const auto alloc_counter_begin = alloc_counter();
+
+  BOOST_CHECK(11 == count_chunks(allocator_type{}, 11 * allocate_block_size));
+  BOOST_CHECK(4 == count_chunks(allocator_type{geometric_growth(4)}, 11 * allocate_block_size));
+  BOOST_CHECK(4 == count_chunks(allocator_type{fixed_growth(3)}, 11 * allocate_block_size));
+  BOOST_CHECK(2 == count_chunks(allocator_type{[] (std::size_t chunks_count) { return 0 == chunks_count ? 1 : 10; }}, 11 * allocate_block_size));
+
+  {
+    allocator_type allocator{fixed_growth(2)};
+    allocator.deallocate(allocator.allocate(1), 1);
+    const auto alloc_counter_empty_pool = alloc_counter();
+
+    std::array<allocator_type::pointer, 2 * allocate_block_size> pointers;
+    for(auto& p : pointers)
+      p = allocator.allocate(1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_empty_pool + 1);
+    for(auto i = 0; i < allocate_block_size; ++i)
+      allocator.deallocate(pointers[i], 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_empty_pool + 1);
+    pointers[0] = allocator.allocate(1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_empty_pool + 1);
+    allocator.deallocate(pointers[0], 1);
+    for(auto i = allocate_block_size; i < 2 * allocate_block_size; ++i)
+      allocator.deallocate(pointers[i], 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_empty_pool);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_over_aligned)
+{
+  struct alignas(128) over_aligned {
+    int value;
+  };
+
+  const auto allocate_block_size{10};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_allocator<over_aligned, allocate_block_size> allocator;
+    std::array<over_aligned*, 2 * allocate_block_size> pointers;
+    for(auto& p : pointers) {
+      p = allocator.allocate(1);
+      BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(p) % alignof(over_aligned));
+    }
+    auto large = allocator.allocate(allocate_block_size + 1);
+    BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(large) % alignof(over_aligned));
+    allocator.deallocate(large, allocate_block_size + 1);
+    for(auto p : pointers)
+      allocator.deallocate(p, 1);
+
+    std::vector<over_aligned, custom_allocator<over_aligned, allocate_block_size>> vector(allocate_block_size);
+    BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(vector.data()) % alignof(over_aligned));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_cache_line_padding)
+{
+  const auto allocate_block_size{10};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_allocator<int, allocate_block_size> allocator{slot_padding::cache_line};
+    std::array<int*, allocate_block_size> pointers;
+    for(auto& p : pointers) {
+      p = allocator.allocate(1);
+      BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(p) % block_pool::cache_line_size);
+    }
+    for(std::size_t i = 1; i < pointers.size(); ++i)
+      BOOST_CHECK(block_pool::cache_line_size <= static_cast<std::size_t>(std::abs(reinterpret_cast<char*>(pointers[i]) - reinterpret_cast<char*>(pointers[i - 1]))));
+    for(auto p : pointers)
+      allocator.deallocate(p, 1);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_retained_empty_blocks)
+{
+  const auto allocate_block_size{10};
+  using allocator_type = custom_allocator<uint64_t, allocate_block_size>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    allocator_type allocator{fixed_growth(), 1};
+    allocator.deallocate(allocator.allocate(1), 1);
+    const auto alloc_counter_retained = alloc_counter();
+
+    std::array<allocator_type::pointer, allocate_block_size> pointers;
+    for(auto& p : pointers)
+      p = allocator.allocate(1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_retained);
+
+    for(auto i = 0; i < 100; ++i)
+      allocator.deallocate(allocator.allocate(1), 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_retained + 1);
+
+    for(auto p : pointers)
+      allocator.deallocate(p, 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_retained);
+
+    allocator.get_pool()->trim();
+    BOOST_CHECK(alloc_counter() == alloc_counter_retained - 1);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_stats)
+{
+  const auto allocate_block_size{10};
+  using allocator_type = custom_allocator<uint64_t, allocate_block_size>;
+  const auto global_stats_begin = block_pool::global_stats();
+  {
+    allocator_type allocator;
+    std::array<allocator_type::pointer, 3 * allocate_block_size / 2> pointers;
+    for(auto& p : pointers)
+      p = allocator.allocate(1);
+    for(auto i = 0; i < allocate_block_size / 2; ++i)
+      allocator.deallocate(pointers[i], 1);
+    auto large = allocator.allocate(allocate_block_size + 1);
+
+    auto stats = allocator.get_pool()->stats();
+    BOOST_CHECK(allocate_block_size == stats.live_slots);
+    BOOST_CHECK(2 * allocate_block_size == stats.capacity_slots);
+    BOOST_CHECK(2 == stats.blocks);
+    BOOST_CHECK(0 == stats.spare_blocks);
+    BOOST_CHECK(2 == stats.chunks);
+    BOOST_CHECK(3 * allocate_block_size / 2 == stats.peak_live_slots);
+    BOOST_CHECK(3 * allocate_block_size / 2 == stats.allocations);
+    BOOST_CHECK(allocate_block_size / 2 == stats.deallocations);
+    BOOST_CHECK(1 == stats.large_allocations);
+    BOOST_CHECK(0.5 == stats.fragmentation());
+    BOOST_CHECK(1.0 == stats.average_scan_length());
+
+    auto global_stats = block_pool::global_stats();
+    BOOST_CHECK(global_stats.allocations - global_stats_begin.allocations == stats.allocations);
+    BOOST_CHECK(global_stats.live_slots - global_stats_begin.live_slots == stats.live_slots);
+
+    allocator.deallocate(large, allocate_block_size + 1);
+    for(auto i = allocate_block_size / 2; i < 3 * allocate_block_size / 2; ++i)
+      allocator.deallocate(pointers[i], 1);
+    stats = allocator.get_pool()->stats();
+    BOOST_CHECK(0 == stats.live_slots);
+    BOOST_CHECK(0 == stats.blocks);
+    BOOST_CHECK(0 == stats.chunks);
+  }
+  auto global_stats = block_pool::global_stats();
+  BOOST_CHECK(global_stats.allocations - global_stats_begin.allocations == 3 * allocate_block_size / 2);
+  BOOST_CHECK(global_stats.live_slots == global_stats_begin.live_slots);
+
+  {
+    custom_allocator<uint64_t, allocate_block_size, allocation_mode::bitset> allocator;
+    std::array<uint64_t*, 2 * allocate_block_size> pointers;
+    for(auto& p : pointers)
+      p = allocator.allocate(1);
+    for(auto i = 0; i < 2 * allocate_block_size; i += 2)
+      allocator.deallocate(pointers[i], 1);
+    BOOST_CHECK(1.0 == allocator.get_pool()->stats().average_scan_length());
+
+    // Three elements take two slots of the size class, both blocks are inspected before
+    // such a run is taken from a new block.
+    auto run = allocator.allocate(3);
+    BOOST_CHECK(1.0 < allocator.get_pool()->stats().average_scan_length());
+    allocator.deallocate(run, 3);
+    for(auto i = 1; i < 2 * allocate_block_size; i += 2)
+      allocator.deallocate(pointers[i], 1);
+  }
+}
+
+template<backing_store BACKING>
+void check_backing_store()
+{
+  const auto allocate_block_size{10};
+  const auto elements_count{10000};
+  using allocator_type = custom_allocator<std::pair<const int, int>, allocate_block_size>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    BOOST_CHECK(1 == count_chunks(custom_allocator<uint64_t, allocate_block_size>{BACKING}, 11 * allocate_block_size));
+
+    std::map<int, int, std::less<int>, allocator_type> map{allocator_type{BACKING, geometric_growth(16)}};
+    for(auto i = 0; i < elements_count; ++i)
+      map.emplace(i, i);
+    for(auto i = 0; i < elements_count; i += 2)
+      map.erase(i);
+    for(auto i = 0; i < elements_count / 2; ++i)
+      map.emplace(i, i);
+    BOOST_CHECK(elements_count / 2 + elements_count / 4 == map.size());
+    BOOST_CHECK(std::all_of(std::cbegin(map), std::cend(map), [] (const auto& element) { return element.first == element.second; }));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_backing_store)
+{
+  check_backing_store<backing_store::pages>();
+  check_backing_store<backing_store::huge_pages>();
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_memory_resource)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    block_pool pool{20};
+    BOOST_CHECK(pool.is_equal(pool));
+    BOOST_CHECK(!pool.is_equal(*std::pmr::new_delete_resource()));
+
+    std::pmr::map<int, int> map_1{&pool};
+    std::pmr::map<int, int> map_2{&pool};
+    map_1.emplace(0, 0);
+    const auto alloc_counter_one_block = alloc_counter();
+    for(auto i = 1; i < 5; ++i)
+      map_1.emplace(i, i);
+    for(auto i = 0; i < 5; ++i)
+      map_2.emplace(i, i);
+    BOOST_CHECK(alloc_counter() == alloc_counter_one_block);
+    BOOST_CHECK(map_1 == map_2);
+
+    std::pmr::vector<int> vector{&pool};
+    vector.reserve(pool.largest_pooled_size() / sizeof(int) + 1);
+    BOOST_CHECK(alloc_counter() == alloc_counter_one_block + 1);
+    std::iota(std::begin(vector), std::end(vector), 0);
+
+    custom_allocator<std::pair<const int, int>, 20> allocator{std::shared_ptr<block_pool>{&pool, [] (block_pool*) {}}};
+    const auto alloc_counter_handle = alloc_counter();
+    std::map<int, int, std::less<int>, decltype(allocator)> map_3{allocator};
+    map_3.emplace(0, 0);
+    BOOST_CHECK(alloc_counter() == alloc_counter_handle);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_synchronized_memory_resource)
+{
+  const auto threads_count = 4;
+  const auto elements_count = 1000;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    auto pool = std::make_shared<synchronized_block_pool>(10);
+    custom_allocator<int, 10> allocator{pool};
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count);
+    std::vector<std::size_t> sums(threads_count);
+    for(auto i = 0; i < threads_count; ++i) {
+      threads.emplace_back([&pool, &allocator, &sums, i, elements_count] () {
+        std::pmr::map<int, int> map{pool.get()};
+        std::list<int, custom_allocator<int, 10>> list{allocator};
+        for(auto j = 0; j < elements_count; ++j) {
+          map.emplace(j, j);
+          list.push_back(j);
+        }
+        for(const auto& element : map)
+          sums[i] += element.second;
+        sums[i] += std::accumulate(std::cbegin(list), std::cend(list), std::size_t{});
+      });
+    }
+    for(auto& thread : threads)
+      thread.join();
+    for(auto sum : sums)
+      BOOST_CHECK(sum == std::size_t{elements_count} * (elements_count - 1));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_synchronized_remote_free)
+{
+  const auto threads_count = 4;
+  const std::size_t elements_count = 1000;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    auto pool = std::make_shared<synchronized_block_pool>(10);
+    custom_allocator<uint64_t, 10> allocator{pool};
+    std::vector<uint64_t*> elements(threads_count * elements_count);
+    for(auto& element : elements)
+      element = allocator.allocate(1);
+    BOOST_CHECK(elements.size() == pool->stats().live_slots);
+
+    std::vector<std::thread> threads;
+    for(auto i = 0; i < threads_count; ++i) {
+      threads.emplace_back([&allocator, &elements, i, elements_count] () {
+        for(std::size_t j = 0; j < elements_count; ++j)
+          allocator.deallocate(elements[i * elements_count + j], 1);
+      });
+    }
+    for(auto& thread : threads)
+      thread.join();
+
+    auto p = allocator.allocate(1);
+    BOOST_CHECK(1 == pool->stats().live_slots);
+    BOOST_CHECK(elements.size() == pool->stats().deallocations);
+    allocator.deallocate(p, 1);
+    pool->trim();
+    BOOST_CHECK(0 == pool->stats().live_slots);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+
+BOOST_AUTO_TEST_SUITE(test_suite_concurrent_allocator)
+
+BOOST_AUTO_TEST_CASE(test_concurrent_allocator_reuse)
+{
+  concurrent_allocator<uint64_t, 10> allocator;
+  auto p1 = allocator.allocate(1);
+  auto p2 = allocator.allocate(1);
+  BOOST_CHECK(p1 != p2);
+  allocator.deallocate(p1, 1);
+  BOOST_CHECK(p1 == allocator.allocate(1));
+  allocator.deallocate(p1, 1);
+  allocator.deallocate(p2, 1);
+
+  auto run = allocator.allocate(100);
+  std::fill(run, run + 100, 0xDEADBEEF);
+  allocator.deallocate(run, 100);
+}
+
+template<template<std::size_t, std::size_t> class Depot>
+void check_cross_thread()
+{
+  using map_type = std::map<int, int, std::less<int>, concurrent_allocator<std::pair<const int, int>, 10, Depot>>;
+  const auto threads_count{4};
+  const auto elements_count{1000};
+
+  std::vector<map_type> maps(threads_count);
+  std::vector<std::thread> producers;
+  for(auto i = 0; i < threads_count; ++i) {
+    producers.emplace_back([&map = maps[i], i] () {
+      for(auto j = 0; j < elements_count; ++j)
+        map.emplace(j, i * j);
+    });
+  }
+  for(auto& producer : producers)
+    producer.join();
+
+  std::vector<std::thread> consumers;
+  for(auto i = 0; i < threads_count; ++i) {
+    consumers.emplace_back([map = std::move(maps[i])] () mutable {
+      for(auto j = 0; j < elements_count; j += 2)
+        map.erase(j);
+    });
+  }
+  for(auto& consumer : consumers)
+    consumer.join();
+
+  map_type map;
+  for(auto j = 0; j < elements_count; ++j)
+    map.emplace(j, j);
+  BOOST_CHECK(elements_count == map.size());
+  BOOST_CHECK(std::all_of(std::cbegin(map), std::cend(map), [] (const auto& pair) { return pair.first == pair.second; }));
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_allocator_cross_thread)
+{
+  check_cross_thread<locked_depot>();
+  check_cross_thread<lockfree_depot>();
+}
+
+// Released by a static destructor, after the thread cache of the main thread is destroyed.
+std::map<int, int, std::less<int>, concurrent_allocator<std::pair<const int, int>, 10, lockfree_depot>> static_map;
+
+BOOST_AUTO_TEST_CASE(test_concurrent_allocator_static_container)
+{
+  for(auto i = 0; i < 100; ++i)
+    static_map.emplace(i, i);
+  BOOST_CHECK(100 == static_map.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_lockfree_depot_stress)
+{
+  const std::size_t threads_count{8};
+  const std::size_t iterations{20000};
+  const std::size_t batch_size{4};
+  lockfree_depot<sizeof(detail::cached_slot), batch_size> depot;
+  std::atomic<std::size_t> errors{0};
+
+  // Every thread marks all slots of the batches it holds, any slot handed out twice
+  // at the same time gets overwritten by another thread.
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < threads_count; ++i) {
+    threads.emplace_back([&depot, &errors, i, iterations] () {
+      std::vector<detail::cached_slot*> slots;
+      for(std::size_t j = 0; j < iterations; ++j) {
+        auto batch = depot.pop_batch();
+        for(auto slot = batch; nullptr != slot; slot = slot->next)
+          slots.push_back(slot);
+        if(slots.size() != batch_size)
+          ++errors;
+
+        for(auto slot : slots)
+          slot->next_batch = reinterpret_cast<detail::cached_slot*>(i);
+        std::this_thread::yield();
+        for(auto slot : slots) {
+          if(reinterpret_cast<detail::cached_slot*>(i) != slot->next_batch)
+            ++errors;
+        }
+
+        for(std::size_t k = 0; k + 1 < slots.size(); ++k)
+          slots[k]->next = slots[k + 1];
+        slots.back()->next = nullptr;
+        depot.push_batch(slots.front());
+        slots.clear();
+      }
+    });
+  }
+  for(auto& thread : threads)
+    thread.join();
+
+  BOOST_CHECK(0 == errors);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
 
 
 
+BOOST_AUTO_TEST_SUITE(test_suite_arena_allocator)
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator_monotonic)
+{
+  using map_type = std::map<int, int, std::less<int>, arena_allocator<std::pair<const int, int>>>;
+  const auto elements_count{1000};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    map_type map;
+    for(auto i = 0; i < elements_count; ++i)
+      map.emplace(i, i);
+    const auto alloc_counter_filled = alloc_counter();
+    BOOST_CHECK(alloc_counter_filled - alloc_counter_begin < 10);
+
+    for(auto i = 0; i < elements_count; i += 2)
+      map.erase(i);
+    BOOST_CHECK(alloc_counter() == alloc_counter_filled);
+    BOOST_CHECK(elements_count / 2 == map.size());
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator_reset)
+{
+  using allocator_type = arena_allocator<std::pair<const int, int>>;
+  using map_type = std::map<int, int, std::less<int>, allocator_type>;
+  const auto elements_count{1000};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    auto memory = std::make_shared<arena>();
+    allocator_type allocator{memory};
+    {
+      map_type map{allocator};
+      for(auto i = 0; i < elements_count; ++i)
+        map.emplace(i, i);
+      BOOST_CHECK(map.get_allocator() == allocator);
+    }
+    memory->reset();
+    const auto alloc_counter_reset = alloc_counter();
+    {
+      map_type map{allocator};
+      for(auto i = 0; i < elements_count; ++i)
+        map.emplace(i, i);
+    }
+    BOOST_CHECK(alloc_counter() == alloc_counter_reset);
+
+    memory->release();
+    BOOST_CHECK(alloc_counter() == alloc_counter_begin + 1);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator_memory_resource)
+{
+  struct alignas(64) over_aligned {
+    char value;
+  };
+
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    arena memory{64};
+    std::pmr::vector<over_aligned> vector{&memory};
+    std::pmr::map<int, int> map{&memory};
+    for(auto i = 0; i < 100; ++i) {
+      vector.push_back(over_aligned{static_cast<char>(i)});
+      map.emplace(i, i);
+      BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(vector.data()) % alignof(over_aligned));
+    }
+    BOOST_CHECK(99 == vector.back().value);
+    BOOST_CHECK(100 == map.size());
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
 BOOST_AUTO_TEST_SUITE(test_suite_custom_forward_list)
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_empty)
@@ -110,7 +973,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_empty)
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_push_front)
 {
-  const auto alloc_counter_begin = alloc_counter;
+  const auto alloc_counter_begin = alloc_counter();
   {
     custom_forward_list<uint64_t> test_container_1;
     test_container_1.push_front(0xDEADBEEF);
@@ -120,7 +983,353 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_push_front)
     BOOST_CHECK(false == test_container_1.empty());
     BOOST_CHECK(0xABADBABE == test_container_1.front());
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+template<typename List>
+bool size_is_consistent(const List& list)
+{
+  return list.size() == static_cast<std::size_t>(std::distance(std::cbegin(list), std::cend(list)));
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_size_consistency)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_forward_list<uint64_t> test_container_1;
+    for(uint64_t i = 0; i < 10; ++i) {
+      test_container_1.push_front(i);
+      BOOST_CHECK(i + 1 == test_container_1.size());
+    }
+    uint64_t value{10};
+    test_container_1.push_front(value);
+    BOOST_CHECK(11 == test_container_1.size());
+    test_container_1.pop_front();
+    BOOST_CHECK(10 == test_container_1.size());
+    BOOST_CHECK(size_is_consistent(test_container_1));
+
+    decltype(test_container_1) test_container_2{test_container_1};
+    BOOST_CHECK(10 == test_container_2.size());
+    test_container_2.pop_front();
+    test_container_2 = test_container_1;
+    BOOST_CHECK(10 == test_container_2.size());
+    BOOST_CHECK(size_is_consistent(test_container_2));
+    auto& self = test_container_2;
+    test_container_2 = self;
+    BOOST_CHECK(10 == test_container_2.size());
+    BOOST_CHECK(size_is_consistent(test_container_2));
+
+    decltype(test_container_1) test_container_3{std::move(test_container_2)};
+    BOOST_CHECK(0 == test_container_2.size());
+    BOOST_CHECK(10 == test_container_3.size());
+    test_container_3.pop_front();
+    test_container_2 = std::move(test_container_3);
+    BOOST_CHECK(0 == test_container_3.size());
+    BOOST_CHECK(9 == test_container_2.size());
+    BOOST_CHECK(size_is_consistent(test_container_2));
+    BOOST_CHECK(size_is_consistent(test_container_3));
+
+    test_container_1.swap(test_container_2);
+    BOOST_CHECK(9 == test_container_1.size());
+    BOOST_CHECK(10 == test_container_2.size());
+    swap(test_container_1, test_container_3);
+    BOOST_CHECK(0 == test_container_1.size());
+    BOOST_CHECK(9 == test_container_3.size());
+
+    test_container_3.clear();
+    BOOST_CHECK(0 == test_container_3.size());
+    BOOST_CHECK(size_is_consistent(test_container_3));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+template<typename List>
+std::vector<typename List::value_type> to_vector(const List& list)
+{
+  return {std::cbegin(list), std::cend(list)};
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_emplace_insert_erase)
+{
+  using pair_type = std::pair<int, std::string>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_forward_list<pair_type> test_container_1;
+    auto& front = test_container_1.emplace_front(1, "one");
+    BOOST_CHECK(&front == &test_container_1.front());
+    BOOST_CHECK(pair_type(1, "one") == front);
+
+    auto itr = test_container_1.emplace_after(test_container_1.cbegin(), 3, "three");
+    BOOST_CHECK(3 == itr->first);
+    itr = test_container_1.insert_after(test_container_1.cbegin(), pair_type{2, "two"});
+    BOOST_CHECK(2 == itr->first);
+    const pair_type zero{0, "zero"};
+    itr = test_container_1.insert_after(test_container_1.cbefore_begin(), zero);
+    BOOST_CHECK(itr == test_container_1.begin());
+    BOOST_CHECK(4 == test_container_1.size());
+    BOOST_CHECK((std::vector<pair_type>{{0, "zero"}, {1, "one"}, {2, "two"}, {3, "three"}} == to_vector(test_container_1)));
+
+    itr = test_container_1.erase_after(test_container_1.cbegin());
+    BOOST_CHECK(2 == itr->first);
+    BOOST_CHECK(3 == test_container_1.size());
+    itr = test_container_1.erase_after(test_container_1.cbefore_begin(), test_container_1.cend());
+    BOOST_CHECK(itr == test_container_1.end());
+    BOOST_CHECK(test_container_1.empty());
+    BOOST_CHECK(0 == test_container_1.size());
+
+    // Arguments are passed to a constructor, not to a braced initializer.
+    custom_forward_list<std::vector<int>> test_container_2;
+    test_container_2.emplace_front(3, 5);
+    BOOST_CHECK((std::vector<int>{5, 5, 5} == test_container_2.front()));
+    test_container_2.emplace_after(test_container_2.cbegin(), 2, 7);
+    BOOST_CHECK((std::vector<int>{7, 7} == *std::next(test_container_2.cbegin())));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_splice_after)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_forward_list<int> test_container_1;
+    custom_forward_list<int> test_container_2;
+    for(auto i = 3; i > 0; --i)
+      test_container_1.push_front(i);
+    for(auto i = 30; i > 0; i -= 10)
+      test_container_2.push_front(i);
+
+    const auto alloc_counter_filled = alloc_counter();
+    test_container_1.splice_after(test_container_1.cbegin(), test_container_2);
+    BOOST_CHECK((std::vector<int>{1, 10, 20, 30, 2, 3} == to_vector(test_container_1)));
+    BOOST_CHECK(6 == test_container_1.size());
+    BOOST_CHECK(test_container_2.empty());
+    BOOST_CHECK(0 == test_container_2.size());
+
+    test_container_2.splice_after(test_container_2.cbefore_begin(), test_container_1, test_container_1.cbegin());
+    BOOST_CHECK((std::vector<int>{1, 20, 30, 2, 3} == to_vector(test_container_1)));
+    BOOST_CHECK((std::vector<int>{10} == to_vector(test_container_2)));
+    BOOST_CHECK(5 == test_container_1.size());
+    BOOST_CHECK(1 == test_container_2.size());
+
+    auto last = std::next(test_container_1.cbegin(), 3);
+    test_container_2.splice_after(test_container_2.cbegin(), test_container_1, test_container_1.cbegin(), last);
+    BOOST_CHECK((std::vector<int>{1, 2, 3} == to_vector(test_container_1)));
+    BOOST_CHECK((std::vector<int>{10, 20, 30} == to_vector(test_container_2)));
+    BOOST_CHECK(3 == test_container_1.size());
+    BOOST_CHECK(3 == test_container_2.size());
+
+    // Splicing within one list keeps its size.
+    test_container_1.splice_after(test_container_1.cbefore_begin(), test_container_1, std::next(test_container_1.cbegin()));
+    BOOST_CHECK((std::vector<int>{3, 1, 2} == to_vector(test_container_1)));
+    BOOST_CHECK(3 == test_container_1.size());
+    BOOST_CHECK(alloc_counter() == alloc_counter_filled);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_splice_after_shared_pool)
+{
+  using allocator_type = custom_allocator<int, 10>;
+  using list_type = custom_forward_list<int, allocator_type>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    allocator_type allocator;
+    list_type test_container_1{allocator};
+    for(auto i = 3; i > 0; --i)
+      test_container_1.push_front(i);
+
+    // Copies take their nodes from the pool of the original, so nodes may move between them.
+    list_type test_container_2{test_container_1};
+    list_type test_container_3;
+    test_container_3 = test_container_1;
+    BOOST_CHECK(9 == allocator.get_pool()->stats().live_slots);
+
+    test_container_1.splice_after(test_container_1.cbefore_begin(), test_container_2);
+    test_container_3.splice_after(test_container_3.cbegin(), test_container_1, test_container_1.cbegin(), std::next(test_container_1.cbegin(), 3));
+    BOOST_CHECK((std::vector<int>{1, 1, 2, 3} == to_vector(test_container_1)));
+    BOOST_CHECK(test_container_2.empty());
+    BOOST_CHECK((std::vector<int>{1, 2, 3, 2, 3} == to_vector(test_container_3)));
+    BOOST_CHECK(9 == allocator.get_pool()->stats().live_slots);
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_sort_merge)
+{
+  using pair_type = std::pair<int, int>;
+  auto by_key = [] (const pair_type& lhs, const pair_type& rhs) { return lhs.first < rhs.first; };
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    std::mt19937 engine;
+    std::uniform_int_distribution<int> distribution{0, 50};
+    std::vector<pair_type> expected;
+    custom_forward_list<pair_type> test_container_1;
+    for(auto i = 0; i < 1000; ++i) {
+      expected.emplace_back(distribution(engine), i);
+      test_container_1.push_front(expected.back());
+    }
+    std::reverse(std::begin(expected), std::end(expected));
+    std::stable_sort(std::begin(expected), std::end(expected), by_key);
+
+    custom_forward_list<pair_type> test_container_2;
+    test_container_2.push_front({60, -1});
+    test_container_2.push_front({25, -1});
+    test_container_2.push_front({-1, -1});
+
+    const auto alloc_counter_filled = alloc_counter();
+    test_container_1.sort(by_key);
+    BOOST_CHECK(expected == to_vector(test_container_1));
+    BOOST_CHECK(1000 == test_container_1.size());
+    test_container_1.merge(test_container_2, by_key);
+    BOOST_CHECK(test_container_2.empty());
+    BOOST_CHECK(0 == test_container_2.size());
+    BOOST_CHECK(1003 == test_container_1.size());
+    BOOST_CHECK(std::is_sorted(test_container_1.cbegin(), test_container_1.cend(), by_key));
+    BOOST_CHECK(pair_type(-1, -1) == test_container_1.front());
+    auto after_equal = std::find_if(test_container_1.cbegin(), test_container_1.cend(),
+                                    [] (const pair_type& value) { return 25 < value.first; });
+    BOOST_CHECK(pair_type(25, -1) == *std::find(test_container_1.cbegin(), after_equal, pair_type(25, -1)));
+    BOOST_CHECK(26 == std::next(std::find(test_container_1.cbegin(), after_equal, pair_type(25, -1)))->first);
+    BOOST_CHECK(alloc_counter() == alloc_counter_filled);
+
+    custom_forward_list<pair_type> test_container_3;
+    test_container_3.sort();
+    BOOST_CHECK(test_container_3.empty());
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_merge_shared_pool)
+{
+  using allocator_type = custom_allocator<int, 10>;
+  using list_type = custom_forward_list<int, allocator_type>;
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    allocator_type allocator;
+    list_type test_container_1{allocator};
+    for(auto i = 9; i > 0; i -= 2)
+      test_container_1.push_front(i);
+    list_type test_container_2{test_container_1};
+    for(auto& value : test_container_2)
+      ++value;
+
+    // The copy shares the pool, so its nodes stay owned by it once merged.
+    test_container_1.merge(test_container_2);
+    BOOST_CHECK((std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10} == to_vector(test_container_1)));
+    BOOST_CHECK(test_container_2.empty());
+    BOOST_CHECK(10 == allocator.get_pool()->stats().live_slots);
+
+    test_container_1.sort(std::greater<int>{});
+    BOOST_CHECK((std::vector<int>{10, 9, 8, 7, 6, 5, 4, 3, 2, 1} == to_vector(test_container_1)));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_unique_remove_reverse)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_forward_list<int> test_container_1;
+    for(auto value : {5, 5, 4, 4, 4, 3, 2, 2, 1, 1})
+      test_container_1.push_front(value);
+
+    BOOST_CHECK(5 == test_container_1.unique());
+    BOOST_CHECK((std::vector<int>{1, 2, 3, 4, 5} == to_vector(test_container_1)));
+    BOOST_CHECK(5 == test_container_1.size());
+
+    test_container_1.reverse();
+    BOOST_CHECK((std::vector<int>{5, 4, 3, 2, 1} == to_vector(test_container_1)));
+
+    BOOST_CHECK(2 == test_container_1.remove_if([] (int value) { return 0 == value % 2; }));
+    BOOST_CHECK((std::vector<int>{5, 3, 1} == to_vector(test_container_1)));
+    BOOST_CHECK(1 == test_container_1.remove(5));
+    BOOST_CHECK(0 == test_container_1.remove(5));
+    BOOST_CHECK((std::vector<int>{3, 1} == to_vector(test_container_1)));
+    BOOST_CHECK(2 == test_container_1.size());
+
+    BOOST_CHECK(2 == test_container_1.remove_if([] (int) { return true; }));
+    BOOST_CHECK(test_container_1.empty());
+    BOOST_CHECK(0 == test_container_1.unique());
+    test_container_1.reverse();
+    BOOST_CHECK(test_container_1.empty());
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_range_construction)
+{
+  const std::size_t elements_count{10000};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    std::vector<int> values(elements_count);
+    std::iota(std::begin(values), std::end(values), 0);
+
+    using allocator_type = custom_allocator<int, 1000>;
+    allocator_type allocator;
+    custom_forward_list<int, allocator_type> test_container_1{std::cbegin(values), std::cend(values), allocator};
+    BOOST_CHECK(values == to_vector(test_container_1));
+    BOOST_CHECK(elements_count == test_container_1.size());
+    // Nodes are taken from blocks in bulk, every block is scanned once rather than once per node.
+    BOOST_CHECK(elements_count / 10 > allocator.get_pool()->stats().scanned_blocks);
+    BOOST_CHECK(elements_count == allocator.get_pool()->stats().allocations);
+
+    test_container_1.assign(std::cbegin(values), std::cbegin(values) + 3);
+    BOOST_CHECK((std::vector<int>{0, 1, 2} == to_vector(test_container_1)));
+    BOOST_CHECK(3 == test_container_1.size());
+
+    const std::vector<int> inserted{10, 11};
+    auto itr = test_container_1.insert_after(test_container_1.cbegin(), std::cbegin(inserted), std::cend(inserted));
+    BOOST_CHECK(11 == *itr);
+    BOOST_CHECK((std::vector<int>{0, 10, 11, 1, 2} == to_vector(test_container_1)));
+    BOOST_CHECK(5 == test_container_1.size());
+    itr = test_container_1.insert_after(test_container_1.cbegin(), std::cend(inserted), std::cend(inserted));
+    BOOST_CHECK(itr == test_container_1.begin());
+
+    std::istringstream stream{"1 2 3"};
+    custom_forward_list<int> test_container_2{std::istream_iterator<int>{stream}, std::istream_iterator<int>{}};
+    BOOST_CHECK((std::vector<int>{1, 2, 3} == to_vector(test_container_2)));
+    BOOST_CHECK(3 == test_container_2.size());
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+// Copies throw once the countdown reaches zero.
+struct throwing_copy
+{
+  explicit throwing_copy(int _value) : value{_value} {}
+
+  throwing_copy(const throwing_copy& other)
+    : value{other.value}
+  {
+    if(0 == countdown--)
+      throw std::runtime_error("copy failed");
+  }
+
+  static int countdown;
+  int value;
+};
+
+int throwing_copy::countdown{-1};
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_construction_throws)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    std::vector<throwing_copy> values;
+    for(auto i = 0; i < 1000; ++i)
+      values.emplace_back(i);
+
+    throwing_copy::countdown = 500;
+    using allocator_type = custom_allocator<throwing_copy, 100>;
+    BOOST_CHECK_THROW((custom_forward_list<throwing_copy, allocator_type>{std::cbegin(values), std::cend(values)}), std::runtime_error);
+
+    throwing_copy::countdown = -1;
+    custom_forward_list<throwing_copy> test_container_1{std::cbegin(values), std::cend(values)};
+    throwing_copy::countdown = 500;
+    BOOST_CHECK_THROW(custom_forward_list<throwing_copy>{test_container_1}, std::runtime_error);
+    throwing_copy::countdown = -1;
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -131,14 +1340,14 @@ struct initialized_one_list
 {
   initialized_one_list()
   {
-    alloc_counter_begin = alloc_counter;
+    alloc_counter_begin = alloc_counter();
 
     test_container_1.push_front(0xDEADBEEF);
     test_container_1.push_front(0xABADBABE);
   }
 
   custom_forward_list<uint64_t> test_container_1;
-  decltype(alloc_counter) alloc_counter_begin;
+  decltype(alloc_counter()) alloc_counter_begin;
 };
 
 BOOST_FIXTURE_TEST_SUITE(fixture_test_suite_custom_forward_list, initialized_one_list)
@@ -151,7 +1360,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_pop_front)
   test_container_1.pop_front();
   BOOST_CHECK(true == test_container_1.empty());
 
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_size)
@@ -165,7 +1374,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_size)
   decltype(test_container_1) test_container_2;
   BOOST_CHECK(0 == test_container_2.size());
 
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_clear)
@@ -174,7 +1383,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_clear)
   test_container_1.clear();
   BOOST_CHECK(true == test_container_1.empty());
 
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_iterator)
@@ -189,7 +1398,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_iterator)
   test_container_1.clear();
   BOOST_CHECK(0 == std::distance(std::cbegin(test_container_1), std::cend(test_container_1)));
 
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_equality)
@@ -202,7 +1411,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_equality)
 
   test_container_1.clear();
   test_container_2.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_copy_ctr)
@@ -220,7 +1429,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_copy_ctr)
 
   test_container_1.clear();
   test_container_2.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_assign)
@@ -239,7 +1448,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_assign)
 
   test_container_1.clear();
   test_container_2.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_move_ctr)
@@ -260,7 +1469,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_move_ctr)
   BOOST_CHECK(address_2 == &test_container_2.front());
 
   test_container_2.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_CASE(test_custom_forward_list_move_asign)
@@ -282,7 +1491,7 @@ BOOST_AUTO_TEST_CASE(test_custom_forward_list_move_asign)
   BOOST_CHECK(address_2 == &test_container_2.front());
 
   test_container_2.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 struct initialized_two_lists : initialized_one_list
@@ -317,7 +1526,7 @@ BOOST_FIXTURE_TEST_CASE(test_custom_forward_list_swap, initialized_two_lists)
   BOOST_CHECK(0x55555555 == test_container_1.front());
 
   test_container_1.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_FIXTURE_TEST_CASE(test_custom_forward_list_swap_global_funtion, initialized_two_lists)
@@ -340,7 +1549,7 @@ BOOST_FIXTURE_TEST_CASE(test_custom_forward_list_swap_global_funtion, initialize
   BOOST_CHECK(0x55555555 == test_container_1.front());
 
   test_container_1.clear();
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -351,7 +1560,7 @@ BOOST_AUTO_TEST_SUITE(test_suite_memory_leak)
 
 BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
 {
-  const auto alloc_counter_begin = alloc_counter;
+  const auto alloc_counter_begin = alloc_counter();
   const auto allocate_block_size{10};
   
   {
@@ -360,7 +1569,7 @@ BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
     std::generate_n(std::front_inserter(container),
                   3 * allocate_block_size,
                   [i=0] () mutable { return i++; });
-    BOOST_CHECK(alloc_counter != alloc_counter_begin);
+    BOOST_CHECK(alloc_counter() != alloc_counter_begin);
 
     container.push_front(31);
     container.push_front(32);
@@ -368,7 +1577,7 @@ BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
     container.pop_front();
     container.pop_front();
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 
   {
     custom_forward_list<int, custom_allocator<int, allocate_block_size>> container;
@@ -383,7 +1592,7 @@ BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
     container.pop_front();
     container.pop_front();
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 
   {
     custom_forward_list<int, custom_allocator<int, allocate_block_size>> container;
@@ -396,7 +1605,7 @@ BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
     container_2.pop_front();
     container_2.pop_front();
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 
   {
     custom_forward_list<int, custom_allocator<int, allocate_block_size>> container;
@@ -410,7 +1619,7 @@ BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
     container_2.pop_front();
     container_2.pop_front();
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
 
   {
     custom_forward_list<int, custom_allocator<int, allocate_block_size>> container;
@@ -425,7 +1634,259 @@ BOOST_AUTO_TEST_CASE(test_suite_memory_leak)
     container.pop_front();
     container.swap(container_2);
   }
-  BOOST_CHECK(alloc_counter == alloc_counter_begin);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_leak_counters_threads)
+{
+  const std::size_t threads_count{8};
+  const std::size_t allocations_count{10000};
+  std::vector<std::thread> threads;
+  threads.reserve(threads_count);
+
+  std::atomic<bool> allocated{false};
+  std::atomic<std::size_t> ready{0};
+  std::vector<std::unique_ptr<int[]>> kept(threads_count);
+  const auto totals_begin = allocation_totals();
+  for(std::size_t i = 0; i < threads_count; ++i) {
+    threads.emplace_back([&, i] () {
+      for(std::size_t j = 0; j < allocations_count; ++j)
+        ::operator delete(::operator new(sizeof(int)));
+      kept[i].reset(new int[100]);
+      ++ready;
+      while(!allocated)
+        std::this_thread::yield();
+    });
+  }
+  while(ready != threads_count)
+    std::this_thread::yield();
+  const auto totals_kept = allocation_totals();
+  allocated = true;
+  for(auto& thread : threads)
+    thread.join();
+  threads.clear();
+
+  BOOST_CHECK(totals_kept.allocations - totals_begin.allocations >= threads_count * (allocations_count + 1));
+  BOOST_CHECK(totals_kept.live_bytes() - totals_begin.live_bytes() >= threads_count * 100 * sizeof(int));
+  for(auto& p : kept)
+    p.reset();
+  BOOST_CHECK(allocation_totals().live_allocations() == totals_begin.live_allocations());
+  BOOST_CHECK(allocation_totals().live_bytes() == totals_begin.live_bytes());
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_leak_pooled_new)
+{
+  const std::size_t threads_count{4};
+  const std::size_t elements_count{10000};
+  using map_type = std::map<std::size_t, std::size_t>;
+
+  auto allocated_by_malloc = new std::size_t{1};
+  const auto alloc_counter_begin = alloc_counter();
+  use_pooled_new(true);
+  BOOST_CHECK(pooled_new_enabled());
+  {
+    std::vector<map_type> maps(threads_count);
+    const auto malloc_calls_begin = malloc_calls();
+    const auto totals_begin = allocation_totals();
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count);
+    for(std::size_t i = 0; i < threads_count; ++i)
+      threads.emplace_back([&maps, i, elements_count] () {
+        for(std::size_t j = 0; j < elements_count; ++j)
+          maps[i].emplace(j, i);
+      });
+    for(auto& thread : threads)
+      thread.join();
+    BOOST_CHECK(malloc_calls() - malloc_calls_begin >= threads_count * elements_count);
+    BOOST_CHECK(allocation_totals().bytes_allocated - totals_begin.bytes_allocated >= threads_count * elements_count * sizeof(map_type::value_type));
+
+    // Nodes are freed by other threads than the ones which allocated them.
+    threads.clear();
+    for(std::size_t i = 0; i < threads_count; ++i)
+      threads.emplace_back([&maps, i, threads_count] () {
+        maps[(i + 1) % threads_count].clear();
+      });
+    for(auto& thread : threads)
+      thread.join();
+    for(const auto& map : maps)
+      BOOST_CHECK(map.empty());
+
+    delete allocated_by_malloc;
+    allocated_by_malloc = nullptr;
+    auto pooled = new std::size_t{2};
+    use_pooled_new(false);
+    BOOST_CHECK(!pooled_new_enabled());
+    delete pooled;
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin - 1);
+}
+
+// The facet is created here and deleted by the locale implementation of the C++ runtime,
+// so both must use the same replacement of operator new and delete.
+BOOST_AUTO_TEST_CASE(test_memory_leak_pooled_new_freed_by_runtime)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  use_pooled_new(true);
+  auto facet = new std::numpunct<char>;
+  {
+    std::locale locale{std::locale::classic(), facet};
+    std::ostringstream out;
+    out.imbue(locale);
+    out << 1000;
+    BOOST_CHECK(out.str() == "1000");
+  }
+  use_pooled_new(false);
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+struct alignas(64) over_aligned_value {
+  int value;
+};
+
+void check_aligned_new()
+{
+  const std::size_t elements_count{1000};
+  const auto alloc_counter_begin = alloc_counter();
+  {
+    custom_forward_list<over_aligned_value> list;
+    std::map<int, over_aligned_value> map;
+    const auto malloc_calls_begin = malloc_calls();
+    for(std::size_t i = 0; i < elements_count; ++i) {
+      list.push_front(over_aligned_value{static_cast<int>(i)});
+      map.emplace(i, over_aligned_value{static_cast<int>(i)});
+      BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(&list.front()) % alignof(over_aligned_value));
+      BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(&map[i]) % alignof(over_aligned_value));
+    }
+    BOOST_CHECK(malloc_calls() - malloc_calls_begin >= 2 * elements_count);
+    BOOST_CHECK(alloc_counter() != alloc_counter_begin);
+    BOOST_CHECK(static_cast<int>(elements_count) - 1 == list.front().value);
+
+    std::unique_ptr<over_aligned_value[]> array{new over_aligned_value[3]};
+    BOOST_CHECK(0 == reinterpret_cast<std::uintptr_t>(array.get()) % alignof(over_aligned_value));
+  }
+  BOOST_CHECK(alloc_counter() == alloc_counter_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_leak_aligned_new)
+{
+  check_aligned_new();
+  use_pooled_new(true);
+  check_aligned_new();
+  use_pooled_new(false);
+}
+
+// Reports are written to temporary files while detection is on and read back after it is
+// stopped, so the strings and streams reading them do not allocate under detection.
+std::string read_report(FILE* report)
+{
+  std::string text(ftell(report), '\0');
+  rewind(report);
+  fread(&text[0], 1, text.size(), report);
+  fclose(report);
+  return text;
+}
+
+template<typename Function>
+bool aborts(Function function)
+{
+  auto pid = fork();
+  if(0 == pid) {
+    // Boost.Test catches signals of the test process, the child has to die of them.
+    std::signal(SIGABRT, SIG_DFL);
+    freopen("/dev/null", "w", stderr);
+    function();
+    _exit(0);
+  }
+  int status{};
+  waitpid(pid, &status, 0);
+  return WIFSIGNALED(status) && SIGABRT == WTERMSIG(status);
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_leak_detection)
+{
+  auto with_leak = tmpfile();
+  auto without_leak = tmpfile();
+  BOOST_REQUIRE(with_leak && without_leak);
+  auto allocated_before = homework3::malloc(8);
+  start_leak_detection();
+  auto leaked = homework3::malloc(16);
+  auto freed = homework3::malloc(24);
+  homework3::free(freed);
+  homework3::free(allocated_before);
+  const auto tracked_with_leak = tracked_allocations_count();
+  write_leak_report(with_leak);
+  homework3::free(leaked);
+  write_leak_report(without_leak);
+  stop_leak_detection();
+
+  std::ostringstream leaked_address;
+  leaked_address << "Leak of 16 bytes at " << leaked;
+  BOOST_CHECK(tracked_with_leak >= 1);
+  BOOST_CHECK(std::string::npos != read_report(with_leak).find(leaked_address.str()));
+  BOOST_CHECK(std::string::npos == read_report(without_leak).find(leaked_address.str()));
+  BOOST_CHECK(!leak_detection_overflowed());
+
+  // Far more allocations than the initial table of any shard holds.
+  const std::size_t allocations_count{300000};
+  std::vector<void*> pointers(allocations_count);
+  start_leak_detection();
+  for(auto& p : pointers)
+    p = homework3::malloc(8);
+  const auto tracked = tracked_allocations_count();
+  for(auto p : pointers)
+    homework3::free(p);
+  stop_leak_detection();
+  BOOST_CHECK(tracked >= allocations_count);
+  BOOST_CHECK(!leak_detection_overflowed());
+
+  BOOST_CHECK(aborts([] () {
+    start_leak_detection();
+    auto p = homework3::malloc(8);
+    homework3::free(p);
+    homework3::free(p);
+  }));
+  BOOST_CHECK(aborts([] () {
+    start_leak_detection(true);
+    std::size_t value{};
+    homework3::free(&value);
+  }));
+  BOOST_CHECK(!aborts([] () {
+    start_leak_detection(true);
+    auto p = homework3::malloc(8);
+    homework3::free(p);
+    p = homework3::malloc(8);
+    homework3::free(p);
+  }));
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_leak_profiling)
+{
+  const std::size_t allocations_count{100};
+  std::vector<char*> pointers;
+  pointers.reserve(allocations_count);
+
+  reset_profile();
+  start_profiling(10);
+  for(std::size_t i = 0; i < allocations_count; ++i)
+    pointers.push_back(new char[1000]);
+  stop_profiling();
+  for(auto p : pointers)
+    delete[] p;
+
+  const auto histogram = allocation_size_histogram();
+  BOOST_CHECK(histogram[9] >= allocations_count);
+  BOOST_CHECK(histogram[10] == 0);
+  BOOST_CHECK(profiled_sites_count() >= 1);
+
+  auto report = tmpfile();
+  BOOST_REQUIRE(report);
+  write_profile_report(report);
+  BOOST_CHECK(ftell(report) > 0);
+  fclose(report);
+
+  reset_profile();
+  BOOST_CHECK(0 == allocation_size_histogram()[9]);
+  BOOST_CHECK(0 == profiled_sites_count());
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -506,4 +1967,456 @@ BOOST_AUTO_TEST_CASE(test_custom_allocator_benchmark)
   boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
 }
 
+// Bitset allocator as it was before word-level scanning: blocks are kept in the order of
+// allocation and every request tests bits one by one from the first block on.
+template<typename T, std::size_t ALLOC_AT_ONCE_COUNT>
+class bit_scan_allocator {
+
+public:
+
+  using value_type = T;
+
+  T* allocate(std::size_t)
+  {
+    std::size_t position{};
+    auto block = std::find_if(std::begin(blocks), std::end(blocks), [&position] (const auto& block) {
+      if(block.second.all())
+        return false;
+      for(position = 0; position < block.second.size(); ++position)
+        if(!block.second[position])
+          return true;
+      return false;
+    });
+    if(std::end(blocks) == block) {
+      blocks.emplace_back(std::make_unique<slot_storage[]>(ALLOC_AT_ONCE_COUNT), std::bitset<ALLOC_AT_ONCE_COUNT>{1});
+      return reinterpret_cast<T*>(blocks.back().first.get());
+    }
+    block->second[position] = 1;
+    return reinterpret_cast<T*>(block->first.get() + position);
+  }
+
+  void deallocate(T* p, std::size_t)
+  {
+    auto slot = reinterpret_cast<slot_storage*>(p);
+    auto block = std::find_if(std::begin(blocks), std::end(blocks), [slot] (const auto& block) {
+      return (slot >= block.first.get()) && (slot < block.first.get() + ALLOC_AT_ONCE_COUNT);
+    });
+    block->second[slot - block->first.get()] = 0;
+    if(block->second.none())
+      blocks.erase(block);
+  }
+
+private:
+
+  using slot_storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+  std::list<std::pair<std::unique_ptr<slot_storage[]>, std::bitset<ALLOC_AT_ONCE_COUNT>>> blocks;
+};
+
+// Every other element of 10 blocks is freed and allocated again, so requests find free
+// slots spread over partly used blocks, and more and more blocks before them are full.
+template<typename Allocator>
+auto FragmentedBenchmark(std::size_t block_size, std::size_t rounds)
+{
+  Allocator allocator;
+  std::vector<typename Allocator::value_type*> pointers(10 * block_size);
+  for(auto& p : pointers)
+    p = allocator.allocate(1);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for(std::size_t round = 0; round < rounds; ++round) {
+    for(std::size_t i = round % 2; i < pointers.size(); i += 2)
+      allocator.deallocate(pointers[i], 1);
+    for(std::size_t i = round % 2; i < pointers.size(); i += 2)
+      pointers[i] = allocator.allocate(1);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  for(auto p : pointers)
+    allocator.deallocate(p, 1);
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+}
+
+template<std::size_t ALLOC_AT_ONCE_COUNT>
+void ModesBenchmark(std::size_t rounds)
+{
+  auto ms = FragmentedBenchmark<bit_scan_allocator<std::uint64_t, ALLOC_AT_ONCE_COUNT>>(ALLOC_AT_ONCE_COUNT, rounds);
+  BOOST_TEST_MESSAGE("elapsed time for bit by bit scan with block size for " << ALLOC_AT_ONCE_COUNT << " elements: " << ms << "ms");
+  ms = FragmentedBenchmark<custom_allocator<std::uint64_t, ALLOC_AT_ONCE_COUNT, allocation_mode::bitset>>(ALLOC_AT_ONCE_COUNT, rounds);
+  BOOST_TEST_MESSAGE("elapsed time for bitset mode with block size for " << ALLOC_AT_ONCE_COUNT << " elements: " << ms << "ms");
+  ms = FragmentedBenchmark<custom_allocator<std::uint64_t, ALLOC_AT_ONCE_COUNT, allocation_mode::free_list>>(ALLOC_AT_ONCE_COUNT, rounds);
+  BOOST_TEST_MESSAGE("elapsed time for free_list mode with block size for " << ALLOC_AT_ONCE_COUNT << " elements: " << ms << "ms");
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_modes_benchmark)
+{
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of freeing and allocating again every other element of 10 blocks");
+  ModesBenchmark<100>(100);
+  ModesBenchmark<1000>(10);
+  ModesBenchmark<10000>(1);
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename Map, typename Allocator>
+auto GrowthBenchmark(std::size_t iterations, const Allocator& allocator)
+{
+  const auto alloc_counter_begin = alloc_counter();
+  auto start = std::chrono::high_resolution_clock::now();
+  std::size_t mallocs_count{};
+  {
+    Map map{allocator};
+    for(std::size_t i = 0; i < iterations; ++i)
+      map.emplace(i, i);
+    mallocs_count = alloc_counter() - alloc_counter_begin;
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::make_pair(std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count(), mallocs_count);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_growth_benchmark)
+{
+  using value_type = std::pair<const std::size_t, std::size_t>;
+  using allocator_type = custom_allocator<value_type, 100>;
+  using map_type = std::map<std::size_t, std::size_t, std::less<std::size_t>, allocator_type>;
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of growth policies of custom_allocator with block size for 100 elements used by std::map");
+  for(std::size_t iterations : {10, 10000, 1000000}) {
+    auto result = GrowthBenchmark<std::map<std::size_t, std::size_t>>(iterations, std::allocator<value_type>{});
+    BOOST_TEST_MESSAGE("std::allocator, " << iterations << " elements: " << result.first << "ms, " << result.second << " mallocs");
+    result = GrowthBenchmark<map_type>(iterations, allocator_type{fixed_growth()});
+    BOOST_TEST_MESSAGE("fixed growth, " << iterations << " elements: " << result.first << "ms, " << result.second << " mallocs");
+    result = GrowthBenchmark<map_type>(iterations, allocator_type{geometric_growth(1024)});
+    BOOST_TEST_MESSAGE("geometric growth up to 1024 blocks, " << iterations << " elements: " << result.first << "ms, " << result.second << " mallocs");
+  }
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename Allocator>
+auto FalseSharingBenchmark(std::size_t threads_count, std::size_t iterations, const Allocator& allocator)
+{
+  std::map<std::size_t, std::atomic<std::size_t>, std::less<std::size_t>, Allocator> counters{allocator};
+  for(std::size_t i = 0; i < threads_count; ++i)
+    counters.emplace(std::piecewise_construct, std::forward_as_tuple(i), std::forward_as_tuple(0));
+
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < threads_count; ++i) {
+    threads.emplace_back([iterations, &counter = counters.at(i)] () {
+      for(std::size_t j = 0; j < iterations; ++j)
+        counter.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+  for(auto& thread : threads)
+    thread.join();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_false_sharing_benchmark)
+{
+  const std::size_t iterations{1000000};
+  using allocator_type = custom_allocator<std::pair<const std::size_t, std::atomic<std::size_t>>, 100>;
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of per-thread counters kept in std::map. Increments per thread = " << iterations);
+  for(std::size_t threads_count : {1, 2, 4, 8}) {
+    auto ms = FalseSharingBenchmark(threads_count, iterations, allocator_type{});
+    BOOST_TEST_MESSAGE("elapsed time for custom_allocator without padding in " << threads_count << " threads: " << ms << "ms");
+    ms = FalseSharingBenchmark(threads_count, iterations, allocator_type{slot_padding::cache_line});
+    BOOST_TEST_MESSAGE("elapsed time for custom_allocator with cache line padding in " << threads_count << " threads: " << ms << "ms");
+  }
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename Map, typename Allocator>
+auto LookupBenchmark(std::size_t elements_count, std::size_t lookups_count, const Allocator& allocator)
+{
+  Map map{allocator};
+  for(std::size_t i = 0; i < elements_count; ++i)
+    map.emplace(i, i);
+
+  std::mt19937_64 engine;
+  std::uniform_int_distribution<std::size_t> distribution{0, elements_count - 1};
+  std::size_t sum{};
+  auto start = std::chrono::high_resolution_clock::now();
+  for(std::size_t i = 0; i < lookups_count; ++i)
+    sum += map.find(distribution(engine))->second;
+  auto end = std::chrono::high_resolution_clock::now();
+  BOOST_CHECK(0 != sum);
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_backing_store_benchmark)
+{
+  const std::size_t elements_count{1000000};
+  const std::size_t lookups_count{1000000};
+  using allocator_type = custom_allocator<std::pair<const std::size_t, std::size_t>, 1000>;
+  using map_type = std::map<std::size_t, std::size_t, std::less<std::size_t>, allocator_type>;
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of random lookups in std::map of " << elements_count << " elements. Lookups = " << lookups_count);
+  auto ms = LookupBenchmark<map_type>(elements_count, lookups_count, allocator_type{backing_store::heap, geometric_growth(64)});
+  BOOST_TEST_MESSAGE("elapsed time for custom_allocator with blocks allocated by malloc: " << ms << "ms");
+  ms = LookupBenchmark<map_type>(elements_count, lookups_count, allocator_type{backing_store::pages, geometric_growth(64)});
+  BOOST_TEST_MESSAGE("elapsed time for custom_allocator with blocks mapped in pages: " << ms << "ms");
+  ms = LookupBenchmark<map_type>(elements_count, lookups_count, allocator_type{backing_store::huge_pages, geometric_growth(64)});
+  BOOST_TEST_MESSAGE("elapsed time for custom_allocator with blocks mapped in huge pages: " << ms << "ms");
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename List, typename Allocator>
+auto BoundaryBenchmark(std::size_t elements_count, std::size_t iterations, const Allocator& allocator)
+{
+  List list{allocator};
+  for(std::size_t i = 0; i < elements_count; ++i)
+    list.push_back(i);
+
+  const auto malloc_calls_begin = malloc_calls();
+  auto start = std::chrono::high_resolution_clock::now();
+  for(std::size_t i = 0; i < iterations; ++i) {
+    list.push_back(i);
+    list.pop_back();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::make_pair(std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count(), malloc_calls() - malloc_calls_begin);
+}
+
+BOOST_AUTO_TEST_CASE(test_pooled_new_benchmark)
+{
+  const std::size_t iterations{1000000};
+  auto pair_generator = [i=0] () mutable {
+    auto value = std::make_pair(i, i);
+    ++i;
+    return value;
+  };
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of std::map with the global operator new. Iterations = " << iterations);
+  auto ms = Benchmark<std::map<int, int>>(iterations, pair_generator);
+  BOOST_TEST_MESSAGE("elapsed time for operator new served by malloc: " << ms << "ms");
+  use_pooled_new(true);
+  ms = Benchmark<std::map<int, int>>(iterations, pair_generator);
+  use_pooled_new(false);
+  BOOST_TEST_MESSAGE("elapsed time for operator new served by size classes: " << ms << "ms");
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+// Live nodes fit into the initial tables of the detector, so every allocation is tracked
+// and the time of growing the tables is left out.
+BOOST_AUTO_TEST_CASE(test_leak_detection_benchmark)
+{
+  const std::size_t iterations{100000};
+  auto pair_generator = [i=0] () mutable {
+    auto value = std::make_pair(i, i);
+    ++i;
+    return value;
+  };
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of std::map with leak detection. Iterations = " << iterations);
+  auto ms = Benchmark<std::map<int, int>>(iterations, pair_generator);
+  BOOST_TEST_MESSAGE("elapsed time without leak detection: " << ms << "ms");
+  start_leak_detection();
+  ms = Benchmark<std::map<int, int>>(iterations, pair_generator);
+  stop_leak_detection();
+  BOOST_CHECK(!leak_detection_overflowed());
+  BOOST_TEST_MESSAGE("elapsed time with leak detection: " << ms << "ms");
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename List>
+auto CopyBenchmark(std::size_t elements_count)
+{
+  List list;
+  for(std::size_t i = 0; i < elements_count; ++i)
+    list.push_front(i);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  List list_copy{list};
+  list_copy = list;
+  auto end = std::chrono::high_resolution_clock::now();
+  BOOST_CHECK(list_copy == list);
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_copy_benchmark)
+{
+  using list_type = custom_forward_list<std::size_t, custom_allocator<std::size_t, 1000>>;
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of copy construction and copy assignment of custom_forward_list");
+  for(std::size_t elements_count = 1000; elements_count <= 1000000; elements_count *= 10) {
+    auto us = CopyBenchmark<list_type>(elements_count);
+    BOOST_TEST_MESSAGE("elapsed time for " << elements_count << " elements: " << us << "us");
+  }
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename List>
+auto SortUniqueBenchmark(std::size_t elements_count, bool in_place)
+{
+  std::mt19937_64 engine;
+  std::uniform_int_distribution<std::size_t> distribution{0, elements_count / 2};
+  List list;
+  for(std::size_t i = 0; i < elements_count; ++i)
+    list.push_front(distribution(engine));
+
+  auto start = std::chrono::high_resolution_clock::now();
+  if(in_place) {
+    list.sort();
+    list.unique();
+  }
+  else {
+    std::vector<std::size_t> vector{std::cbegin(list), std::cend(list)};
+    std::sort(std::begin(vector), std::end(vector));
+    vector.erase(std::unique(std::begin(vector), std::end(vector)), std::end(vector));
+    list.clear();
+    for(auto itr = vector.crbegin(); itr != vector.crend(); ++itr)
+      list.push_front(*itr);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  BOOST_CHECK(std::is_sorted(std::cbegin(list), std::cend(list)));
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_forward_list_sort_benchmark)
+{
+  using list_type = custom_forward_list<std::size_t, custom_allocator<std::size_t, 1000>>;
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of sort and unique of custom_forward_list");
+  for(std::size_t elements_count = 1000; elements_count <= 1000000; elements_count *= 10) {
+    auto ms = SortUniqueBenchmark<list_type>(elements_count, true);
+    BOOST_TEST_MESSAGE("elapsed time for " << elements_count << " elements sorted in place: " << ms << "ms");
+    ms = SortUniqueBenchmark<list_type>(elements_count, false);
+    BOOST_TEST_MESSAGE("elapsed time for " << elements_count << " elements sorted in std::vector: " << ms << "ms");
+  }
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_allocator_retained_blocks_benchmark)
+{
+  const std::size_t elements_count{100};
+  const std::size_t iterations{100000};
+  using allocator_type = custom_allocator<std::size_t, elements_count>;
+  using list_type = std::list<std::size_t, allocator_type>;
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of push_back and pop_back at a block boundary of std::list. Iterations = " << iterations);
+  auto result = BoundaryBenchmark<std::list<std::size_t>>(elements_count, iterations, std::allocator<std::size_t>{});
+  BOOST_TEST_MESSAGE("elapsed time for std::allocator: " << result.first << "ms, " << result.second << " mallocs");
+  result = BoundaryBenchmark<list_type>(elements_count, iterations, allocator_type{fixed_growth()});
+  BOOST_TEST_MESSAGE("elapsed time for custom_allocator without retained blocks: " << result.first << "ms, " << result.second << " mallocs");
+  result = BoundaryBenchmark<list_type>(elements_count, iterations, allocator_type{fixed_growth(), 1});
+  BOOST_TEST_MESSAGE("elapsed time for custom_allocator with 1 retained block: " << result.first << "ms, " << result.second << " mallocs");
+  BOOST_CHECK(1 >= result.second);
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename Map, typename Allocator, typename Reset>
+auto CyclesBenchmark(std::size_t cycles, std::size_t iterations, const Allocator& allocator, const Reset& reset)
+{
+  auto start = std::chrono::high_resolution_clock::now();
+  for(std::size_t i = 0; i < cycles; ++i) {
+    {
+      Map map{allocator};
+      for(std::size_t j = 0; j < iterations; ++j)
+        map.emplace(j, j);
+    }
+    reset();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator_benchmark)
+{
+  const std::size_t cycles{100};
+  const std::size_t iterations{1000};
+  using value_type = std::pair<const std::size_t, std::size_t>;
+  auto no_reset = [] () {};
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of std::map built and destroyed " << cycles << " times. Iterations per cycle = " << iterations);
+  auto ms = CyclesBenchmark<std::map<std::size_t, std::size_t>>(cycles, iterations, std::allocator<value_type>{}, no_reset);
+  BOOST_TEST_MESSAGE("elapsed time for std::allocator: " << ms << "ms");
+  ms = CyclesBenchmark<std::map<std::size_t, std::size_t, std::less<std::size_t>, custom_allocator<value_type, 1000>>>(cycles, iterations, custom_allocator<value_type, 1000>{}, no_reset);
+  BOOST_TEST_MESSAGE("elapsed time for custom_allocator with block size for 1000 elements: " << ms << "ms");
+  auto memory = std::make_shared<arena>();
+  ms = CyclesBenchmark<std::map<std::size_t, std::size_t, std::less<std::size_t>, arena_allocator<value_type>>>(cycles, iterations, arena_allocator<value_type>{memory}, [&memory] () { memory->reset(); });
+  BOOST_TEST_MESSAGE("elapsed time for arena_allocator reset after every cycle: " << ms << "ms");
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
+template<typename Map>
+auto MultithreadedBenchmark(std::size_t threads_count, std::size_t iterations)
+{
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < threads_count; ++i) {
+    threads.emplace_back([iterations] () {
+      Map map;
+      for(std::size_t j = 0; j < iterations; ++j)
+        map.emplace(j, j);
+      for(std::size_t j = 0; j < iterations; j += 2)
+        map.erase(j);
+      for(std::size_t j = 0; j < iterations; j += 2)
+        map.emplace(j, j);
+    });
+  }
+  for(auto& thread : threads)
+    thread.join();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_allocator_benchmark)
+{
+  const std::size_t iterations{100000};
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_messages );
+
+  BOOST_TEST_MESSAGE("Benchmark of std::allocator and concurrent_allocator used by std::map in every thread. Iterations per thread = " << iterations);
+  for(std::size_t threads_count : {1, 2, 4, 8}) {
+    auto ms = MultithreadedBenchmark<std::map<std::size_t, std::size_t>>(threads_count, iterations);
+    BOOST_TEST_MESSAGE("elapsed time for std::allocator in " << threads_count << " threads: " << ms << "ms");
+    ms = MultithreadedBenchmark<std::map<std::size_t, std::size_t, std::less<std::size_t>, concurrent_allocator<std::pair<const std::size_t, std::size_t>, 1000>>>(threads_count, iterations);
+    BOOST_TEST_MESSAGE("elapsed time for concurrent_allocator in " << threads_count << " threads: " << ms << "ms");
+    ms = MultithreadedBenchmark<std::map<std::size_t, std::size_t, std::less<std::size_t>, concurrent_allocator<std::pair<const std::size_t, std::size_t>, 1000, lockfree_depot>>>(threads_count, iterations);
+    BOOST_TEST_MESSAGE("elapsed time for concurrent_allocator with lockfree_depot in " << threads_count << " threads: " << ms << "ms");
+  }
+
+  boost::unit_test::unit_test_log_t::instance().set_threshold_level( boost::unit_test::log_all_errors );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
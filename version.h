@@ -6,7 +6,7 @@ namespace homework3 {
 struct version_info{
 
   version_info()
-    { version_info(0, 0, 0); }
+    : version_info(0, 0, 0) {}
 
   version_info(const int major,
                const int minor,